@@ -15,6 +15,7 @@ export namespace core {
 		rw = ro | wo,
 		txt = 1 << 2,
 		app = 1 << 3,
+		trunc = 1 << 4,
 	};
 
 	ENUM_CLASS_OPERATORS(access);
@@ -115,4 +116,68 @@ export namespace core {
 	}
 
 	file_base fopen_raw(stringview fname, access _access);
+
+	// last write time in an os specific unit, only meant to be compared, 0 if the file is missing
+	u64 fmodified(stringview fname);
+
+	// os change notification on the directories holding a set of files, it only says that
+	// something was written, callers compare fmodified to find out what
+	struct fwatch {
+		fwatch()
+		: handles(0)
+		, dirs(0) {}
+
+		fwatch(cref<fwatch> other) = delete;
+		~fwatch();
+
+		// watches the directory containing fname, each directory is only watched once
+		void add(stringview fname);
+
+		// true when something was written before ms passed, the notification is rearmed
+		// before returning so writes made while the caller reacts are not lost
+		bool wait(u32 ms);
+
+		vector<ptr<void>> handles;
+		vector<string> dirs;
+	};
+
+	// read only view of a whole file, pages are only loaded once they are touched
+	// data is nullptr if the file could not be opened or is empty
+	struct file_map {
+		file_map()
+		: data(nullptr), size(0), handle() {}
+
+		file_map(stringview fname);
+
+		file_map(fwd<file_map> other)
+		: data(nullptr), size(0), handle() {
+			*this = forward_data(other);
+		}
+
+		~file_map();
+
+		ref<file_map> operator=(fwd<file_map> other) {
+			// swapped so other releases whatever this held
+			cptr<u8> tmp_data = data;
+			u32 tmp_size = size;
+			core::handle tmp_handle = handle;
+
+			data = other.data;
+			size = other.size;
+			handle = other.handle;
+
+			other.data = tmp_data;
+			other.size = tmp_size;
+			other.handle = tmp_handle;
+			return *this;
+		}
+
+		cptr<u8> data;
+		u32 size;
+		core::handle handle;
+	};
+
+	file_map fmap(stringview fname) {
+		return file_map(fname);
+	}
 }
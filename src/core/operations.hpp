@@ -87,4 +87,47 @@ export namespace core {
 	void swap(ref<T> a, ref<T> b) {
 		op_mem<T>::swap(a, b);
 	}
+
+	// stable bottom up merge sort, less(a, b) is true when a goes before b
+	// scratch needs room for count items, meant for small trivially copyable items like indices
+	template <typename T, typename Less>
+	void merge_sort(ptr<T> data, ptr<T> scratch, u32 count, Less less) {
+		constexpr u32 RUN = 16;
+		for (u32 beg = 0; beg < count; beg += RUN) {
+			u32 end = min(beg + RUN, count);
+			for (u32 i = beg + 1; i < end; i++) {
+				T item = data[i];
+				u32 j = i;
+				while (j > beg && less(item, data[j - 1])) {
+					data[j] = data[j - 1];
+					j--;
+				}
+
+				data[j] = item;
+			}
+		}
+
+		ptr<T> src = data;
+		ptr<T> dst = scratch;
+		for (u32 width = RUN; width < count; width *= 2) {
+			for (u32 beg = 0; beg < count; beg += 2 * width) {
+				u32 mid = min(beg + width, count);
+				u32 end = min(beg + 2 * width, count);
+				u32 a = beg, b = mid, k = beg;
+
+				while (a < mid && b < end) dst[k++] = less(src[b], src[a]) ? src[b++] : src[a++];
+				while (a < mid) dst[k++] = src[a++];
+				while (b < end) dst[k++] = src[b++];
+			}
+
+			ptr<T> tmp = src;
+			src = dst;
+			dst = tmp;
+		}
+
+		if (src == data) return;
+		for (u32 i = 0; i < count; i++) {
+			data[i] = src[i];
+		}
+	}
 };
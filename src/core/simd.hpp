@@ -94,6 +94,147 @@ export namespace core {
 		}
 	}
 
+	// swaps the raw bytes of two objects, objects are treated as trivially relocatable
+	void swap8(ptr<u8> a, ptr<u8> b, u32 bytes) {
+		for (u32 i = 0; i < bytes; i++) {
+			u8 tmp = a[i];
+			a[i] = b[i];
+			b[i] = tmp;
+		}
+	}
+
+	u32 tzcnt64(u64 x) {
+		return (u32)_tzcnt_u64(x);
+	}
+
+	// writes every key whose table entry, masked by mask, equals value and returns the count written
+	// keys are masked by key_mask before indexing, out needs room for count keys
+	u32 filter64(cptr<u64> table, cptr<u32> keys, u32 key_mask, u32 count, u64 mask, u64 value, ptr<u32> out) {
+		const __m128i vkey = _mm_set1_epi32((i32)key_mask);
+		const __m256i vmask = _mm256_set1_epi64x((i64)mask);
+		const __m256i vvalue = _mm256_set1_epi64x((i64)value);
+
+		u32 n = 0;
+		u32 i = 0;
+		for (; i + 4 <= count; i += 4) {
+			__m128i idx = _mm_and_si128(_mm_loadu_si128((cptr<__m128i>)&keys[i]), vkey);
+			__m256i sig = _mm256_i32gather_epi64((cptr<i64>)table, idx, 8);
+			__m256i eq = _mm256_cmpeq_epi64(_mm256_and_si256(sig, vmask), vvalue);
+			u32 bits = (u32)_mm256_movemask_pd(_mm256_castsi256_pd(eq));
+
+			// branchless compaction, n never passes i + 3
+			out[n] = keys[i + 0]; n += bits & 1;
+			out[n] = keys[i + 1]; n += (bits >> 1) & 1;
+			out[n] = keys[i + 2]; n += (bits >> 2) & 1;
+			out[n] = keys[i + 3]; n += (bits >> 3) & 1;
+		}
+
+		for (; i < count; i++) {
+			u32 key = keys[i];
+			if ((table[key & key_mask] & mask) == value) out[n++] = key;
+		}
+
+		return n;
+	}
+
+	// strided f32 kernels, base points at the first value and consecutive values are stride bytes apart
+	// eight values are gathered per step, the base pointer advances so offsets stay small
+	__m256i stride_index256(u32 stride) {
+		return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((i32)stride));
+	}
+
+	f32 hsum256(__m256 v) {
+		__m128 x = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+		x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+		return _mm_cvtss_f32(x);
+	}
+
+	f32 sum256_f32(cptr<u8> base, u32 stride, u32 count) {
+		const __m256i idx = stride_index256(stride);
+		__m256 acc = _mm256_setzero_ps();
+
+		u32 i = 0;
+		for (; i + 8 <= count; i += 8) {
+			acc = _mm256_add_ps(acc, _mm256_i32gather_ps((cptr<f32>)(base + i * stride), idx, 1));
+		}
+
+		f32 total = hsum256(acc);
+		for (; i < count; i++) {
+			total += *(cptr<f32>)(base + i * stride);
+		}
+
+		return total;
+	}
+
+	void minmax256_f32(cptr<u8> base, u32 stride, u32 count, ref<f32> lo, ref<f32> hi) {
+		const __m256i idx = stride_index256(stride);
+		__m256 vlo = _mm256_set1_ps(F32_MAX);
+		__m256 vhi = _mm256_set1_ps(-F32_MAX);
+
+		u32 i = 0;
+		for (; i + 8 <= count; i += 8) {
+			__m256 v = _mm256_i32gather_ps((cptr<f32>)(base + i * stride), idx, 1);
+			vlo = _mm256_min_ps(vlo, v);
+			vhi = _mm256_max_ps(vhi, v);
+		}
+
+		alignas(BLOCK_32) f32 lanes_lo[8];
+		alignas(BLOCK_32) f32 lanes_hi[8];
+		_mm256_store_ps(lanes_lo, vlo);
+		_mm256_store_ps(lanes_hi, vhi);
+
+		lo = F32_MAX;
+		hi = -F32_MAX;
+		for (u32 j = 0; j < 8; j++) {
+			lo = lanes_lo[j] < lo ? lanes_lo[j] : lo;
+			hi = lanes_hi[j] > hi ? lanes_hi[j] : hi;
+		}
+
+		for (; i < count; i++) {
+			f32 v = *(cptr<f32>)(base + i * stride);
+			lo = v < lo ? v : lo;
+			hi = v > hi ? v : hi;
+		}
+	}
+
+	// v = v * scale + offset, there is no scatter in avx2 so results are stored lane by lane
+	void affine256_f32(ptr<u8> base, u32 stride, u32 count, f32 scale, f32 offset) {
+		const __m256i idx = stride_index256(stride);
+		const __m256 vscale = _mm256_set1_ps(scale);
+		const __m256 voffset = _mm256_set1_ps(offset);
+
+		u32 i = 0;
+		alignas(BLOCK_32) f32 lanes[8];
+		for (; i + 8 <= count; i += 8) {
+			ptr<u8> block = base + i * stride;
+			__m256 v = _mm256_i32gather_ps((cptr<f32>)block, idx, 1);
+			_mm256_store_ps(lanes, _mm256_add_ps(_mm256_mul_ps(v, vscale), voffset));
+			for (u32 j = 0; j < 8; j++) {
+				*(ptr<f32>)(block + j * stride) = lanes[j];
+			}
+		}
+
+		for (; i < count; i++) {
+			ptr<f32> v = (ptr<f32>)(base + i * stride);
+			*v = *v * scale + offset;
+		}
+	}
+
+	// AoS to SoA, out receives count contiguous values
+	void gather256_f32(cptr<u8> base, u32 stride, u32 count, ptr<f32> out) {
+		const __m256i idx = stride_index256(stride);
+
+		u32 i = 0;
+		for (; i + 8 <= count; i += 8) {
+			_mm256_storeu_ps(out + i, _mm256_i32gather_ps((cptr<f32>)(base + i * stride), idx, 1));
+		}
+
+		for (; i < count; i++) {
+			out[i] = *(cptr<f32>)(base + i * stride);
+		}
+	}
+
 	template <typename T, typename S>
 	T cast(cref<S> val) {
 		T dst;
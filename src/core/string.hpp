@@ -26,14 +26,12 @@ export namespace core {
 		}
 
 		stringview_base(cptr<type> str, u32 sz)
-		: data(nullptr), size(sz) {
-			*this = str;
-		}
+		: data(str), size(sz) {}
 
 		ref<this_type> operator=(cptr<type> str) {
 			u32 count = 0;
 			while (str[count]) {
-				count++
+				count++;
 			}
 
 			data = str;
@@ -48,7 +46,7 @@ export namespace core {
 
 		bool operator==(cref<this_type> other) const {
 			if (size != other.size) return false;
-			return cmp8((ptr<u8>)data, (ptr<u8>)other.data, size));
+			return cmp8((ptr<u8>)data, (ptr<u8>)other.data, size);
 		}
 
 		auto begin() const {
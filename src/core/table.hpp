@@ -105,7 +105,11 @@ export namespace core {
 		}
 
 		option<u32> _find(cref<key_type> key) const {
-			u32 h = _hash(key);
+			return _find(key, _hash(key));
+		}
+
+		// h is what _hash(key) returns
+		option<u32> _find(cref<key_type> key, u32 h) const {
 			for (i32 i : range(TABLE_PROBE)) {
 				u32 idx = (h + i) % reserve;
 				u32 tmp = _keys.get<HASH_INDEX>(idx);
@@ -121,6 +125,20 @@ export namespace core {
 			return _find(key);
 		}
 
+		// nullptr on a miss, never inserts
+		cptr<val_type> find(cref<key_type> key) const {
+			auto idx = _find(key);
+			if (!idx) return nullptr;
+			return &_vals.get<VAL_INDEX>(_keys.get<SPARSE_INDEX>(idx.get()));
+		}
+
+		// for keys whose hash the caller already has, e.g. built up incrementally
+		cptr<val_type> find(cref<key_type> key, u32 hash) const {
+			auto idx = _find(key, hash | (hash == 0));
+			if (!idx) return nullptr;
+			return &_vals.get<VAL_INDEX>(_keys.get<SPARSE_INDEX>(idx.get()));
+		}
+
 		void set(cref<key_type> key, val_type&& val) {
 			auto idx = _find(key);
 			if (idx) {
@@ -38,4 +38,7 @@ export namespace core {
 
 		core::handle handle;
 	};
+
+	// logical processors available to the process
+	u32 hardware_threads();
 }
@@ -29,6 +29,21 @@ export namespace core {
 	template <typename T>
 	inline constexpr bool is_constructible_v = is_constructible<T>::value;
 
+	template <typename T>
+	struct is_trivially_copyable : public bool_constant<__is_trivially_copyable(T)> {};
+
+	template <typename T>
+	inline constexpr bool is_trivially_copyable_v = is_trivially_copyable<T>::value;
+
+	template <typename T, typename U>
+	struct is_same : public bool_constant<false> {};
+
+	template <typename T>
+	struct is_same<T, T> : public bool_constant<true> {};
+
+	template <typename T, typename U>
+	inline constexpr bool is_same_v = is_same<T, U>::value;
+
 	template<typename T>
 	struct remove_ref {
 		typedef T type;
@@ -2,6 +2,7 @@ module;
 
 #ifdef _MSC_VER
 #include <limits.h>
+#include <float.h>
 #endif
 
 export module core.types;
@@ -41,6 +42,8 @@ export {
 	constexpr u32 U16_MAX = __UINT16_MAX__;
 	constexpr u32 U32_MAX = __UINT32_MAX__;
 	constexpr u64 U64_MAX = __UINT64_MAX__;
+
+	constexpr f32 F32_MAX = __FLT_MAX__;
 #endif
 
 #ifdef _MSC_VER
@@ -66,6 +69,8 @@ export {
 	constexpr u32 U16_MAX = USHRT_MAX;
 	constexpr u32 U32_MAX = UINT_MAX;
 	constexpr u64 U64_MAX = ULLONG_MAX;
+
+	constexpr f32 F32_MAX = FLT_MAX;
 #endif
 }
 
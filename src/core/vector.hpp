@@ -125,6 +125,10 @@ export namespace core {
 			zero8((ptr<u8>)&data[size], sizeof(type));
 		}
 
+		ref<type> operator[](u32 idx) const {
+			return data[idx];
+		}
+
 		u32 find(cref<type> other) const {
 			for (u32 i : range(size)) {
 				if (cmpeq(data[i], other)) {
@@ -165,6 +169,37 @@ export namespace core {
 		u32 size;
 	};
 
+	// non owning view over contiguous memory
+	template<typename T>
+	struct span {
+		using type = T;
+		using this_type = span<type>;
+
+		span()
+		: data(nullptr), size(0) {}
+
+		span(ptr<type> in, u32 sz)
+		: data(in), size(sz) {}
+
+		span(cref<vector<remove_const_t<type>>> in)
+		: data(in.data), size(in.size) {}
+
+		ref<type> operator[](u32 idx) const {
+			return data[idx];
+		}
+
+		auto begin() const {
+			return iterator::wforward_seq(data, 0);
+		}
+
+		auto end() const {
+			return iterator::wforward_seq(data, size);
+		}
+
+		ptr<type> data;
+		u32 size;
+	};
+
 	template<typename T, u32 N>
 	struct array {
 		static constexpr u32 size = N;
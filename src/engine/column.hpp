@@ -0,0 +1,143 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.column;
+import core.types;
+import core.simd;
+import core.iterator;
+import math.vec;
+import jolly.ecs;
+
+export namespace jolly {
+	// byte offset of a member, the storage is never constructed
+	template <typename S, typename C>
+	u32 member_offset(S C::* member) {
+		alignas(C) u8 storage[sizeof(C)];
+		return (u32)((ptr<u8>)&(((ptr<C>)storage)->*member) - storage);
+	}
+
+	// strided view of one field across a pool's components, no data is copied
+	// the view does not lock anything, hold a rview/wview of the pool while using it
+	// columns are invalidated by anything that reallocates the pool
+	// columns of a tracked pool carry its changed ticks, the mutating kernels stamp the whole
+	// range, writes through operator[] must be followed by touch() to be seen
+	template <typename F>
+	struct column {
+		using type = F;
+
+		column()
+		: data(nullptr)
+		, stride(0)
+		, size(0)
+		, ticks(nullptr)
+		, clock(nullptr) {}
+
+		column(ptr<u8> base, u32 step, u32 count, ptr<u32> changed = nullptr, cptr<u32> tick = nullptr)
+		: data(base)
+		, stride(step)
+		, size(count)
+		, ticks(changed)
+		, clock(tick) {}
+
+		ref<type> operator[](u32 idx) const {
+			return *(ptr<type>)(data + idx * stride);
+		}
+
+		// narrows the column to a member of F, e.g. pos.field(&math::vec2f::x)
+		template <typename S>
+		column<S> field(S type::* member) const {
+			return column<S>(data + member_offset(member), stride, size, ticks, clock);
+		}
+
+		// marks every component in the column as changed now
+		void touch() const {
+			if (!clock) return;
+			u32 now = *clock;
+			for (u32 i : core::range(size)) {
+				ticks[i] = now;
+			}
+		}
+
+		// copies the column into count contiguous values
+		void gather(ptr<type> out) const {
+			for (u32 i : core::range(size)) {
+				out[i] = (*this)[i];
+			}
+		}
+
+		void scatter(cptr<type> in) const {
+			for (u32 i : core::range(size)) {
+				(*this)[i] = in[i];
+			}
+
+			touch();
+		}
+
+		ptr<u8> data;
+		u32 stride;
+		u32 size;
+		ptr<u32> ticks; // changed ticks of the pool, indexed like the column
+		cptr<u32> clock; // nullptr for untracked pools
+	};
+
+	template <typename T, typename F>
+	column<F> column_of(ref<pool<T>> p, F T::* member) {
+		ptr<u8> base = (ptr<u8>)p.components.data + member_offset(member);
+		if (!p.tracked()) return column<F>(base, sizeof(T), p.components.size);
+		return column<F>(base, sizeof(T), p.components.size, p.changed.data, p.clock);
+	}
+
+	struct aabb2f {
+		math::vec2f min;
+		math::vec2f max;
+	};
+
+	void column_gather(cref<column<f32>> c, ptr<f32> out) {
+		core::gather256_f32(c.data, c.stride, c.size, out);
+	}
+
+	f32 column_sum(cref<column<f32>> c) {
+		return core::sum256_f32(c.data, c.stride, c.size);
+	}
+
+	math::vec2f column_sum(cref<column<math::vec2f>> c) {
+		return math::vec2f{ column_sum(c.field(&math::vec2f::x)), column_sum(c.field(&math::vec2f::y)) };
+	}
+
+	f32 column_min(cref<column<f32>> c) {
+		f32 lo, hi;
+		core::minmax256_f32(c.data, c.stride, c.size, lo, hi);
+		return lo;
+	}
+
+	f32 column_max(cref<column<f32>> c) {
+		f32 lo, hi;
+		core::minmax256_f32(c.data, c.stride, c.size, lo, hi);
+		return hi;
+	}
+
+	// an empty column gives min = F32_MAX, max = -F32_MAX
+	aabb2f column_aabb(cref<column<math::vec2f>> c) {
+		aabb2f box;
+		auto x = c.field(&math::vec2f::x);
+		auto y = c.field(&math::vec2f::y);
+		core::minmax256_f32(x.data, x.stride, x.size, box.min.x, box.max.x);
+		core::minmax256_f32(y.data, y.stride, y.size, box.min.y, box.max.y);
+		return box;
+	}
+
+	// v = v * scale + offset
+	void column_affine(cref<column<f32>> c, f32 scale, f32 offset) {
+		core::affine256_f32(c.data, c.stride, c.size, scale, offset);
+		c.touch();
+	}
+
+	void column_affine(cref<column<math::vec2f>> c, math::vec2f scale, math::vec2f offset) {
+		auto x = c.field(&math::vec2f::x);
+		auto y = c.field(&math::vec2f::y);
+		core::affine256_f32(x.data, x.stride, x.size, scale.x, offset.x);
+		core::affine256_f32(y.data, y.stride, y.size, scale.y, offset.y);
+		c.touch();
+	}
+}
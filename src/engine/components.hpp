@@ -1,5 +1,7 @@
 export module jolly.components;
+import core.types;
 import math.vec;
+import jolly.ecs;
 
 export namespace jolly {
 	struct quad_component {
@@ -7,4 +9,16 @@ export namespace jolly {
 		math::vec2f scale;
 		math::vec3f color;
 	};
+
+	// local transform relative to the parent, rotation is in radians
+	struct transform_component {
+		math::vec2f pos;
+		math::vec2f scale;
+		f32 rotation;
+	};
+
+	// entities without a hierarchy_component, or whose parent has no transform, are roots
+	struct hierarchy_component {
+		e_id parent;
+	};
 }
@@ -1,15 +1,19 @@
 module;
 
 #include <core/core.h>
+#include <new>
 
 export module jolly.ecs;
 import core.types;
 import core.vector;
+import core.memory;
 import core.simd;
 import core.tuple;
 import core.lock;
 import core.traits;
 import core.iterator;
+import core.operations;
+import core.atom;
 
 namespace impl_ecs {
 	template <typename S>
@@ -45,6 +49,20 @@ namespace impl_ecs {
 
 		cref<S> data;
 	};
+
+	inline core::atom<u32> type_count(0);
+
+	// process wide id of T, every ecs maps it to a slot of its own
+	template <typename T>
+	u32 type_id() {
+		static u32 id = [] {
+			u32 cur = type_count.get(core::memory_order_relaxed);
+			while (!type_count.cmpxchg(cur, cur + 1, core::memory_order_relaxed, core::memory_order_relaxed));
+			return cur;
+		}();
+
+		return id;
+	}
 }
 
 export namespace jolly {
@@ -52,6 +70,9 @@ export namespace jolly {
 		static constexpr u32 gen_mask = U8_MAX << 24;
 		static constexpr u32 id_mask = U32_MAX & (~gen_mask);
 
+		// generations wrap at U8_MAX, the last generation marks placeholders created by ecs_commands
+		static constexpr u32 pending_gen = U8_MAX;
+
 		u32 gen() const {
 			return (_id & gen_mask) >> 24;
 		}
@@ -64,38 +85,112 @@ export namespace jolly {
 			return id();
 		}
 
+		bool pending() const {
+			return gen() == pending_gen;
+		}
+
 		u32 _id;
 	};
 
+	constexpr u32 SPARSE_PAGE_SHIFT = 12;
+	constexpr u32 SPARSE_PAGE_SIZE = 1 << SPARSE_PAGE_SHIFT;
+	constexpr u32 SPARSE_PAGE_MASK = SPARSE_PAGE_SIZE - 1;
+
+	// shared read only page filled with U32_MAX, unallocated pages point here so lookups
+	// only need a bounds check on the page table
+	ptr<u32> sparse_null_page() {
+		static ptr<u32> page = []() {
+			u32 bytes = SPARSE_PAGE_SIZE * sizeof(u32);
+			ptr<u32> data = (ptr<u32>)core::alloc256(bytes).data;
+			core::set256(U32_MAX, (ptr<u8>)data, bytes);
+			return data;
+		}();
+
+		return page;
+	}
+
+	// sparse indices are stored in lazily allocated pages of SPARSE_PAGE_SIZE entries
+	// memory is proportional to the pages actually touched instead of the largest entity id
 	struct sparse_set {
 		sparse_set()
-		: sparse(0)
+		: pages(0)
 		, dense(0) {
-			core::set256(U32_MAX, (ptr<u8>)&sparse[0], sparse.reserve);
-			core::set256(U32_MAX, (ptr<u8>)&dense[0], sparse.reserve);
+			core::set256(U32_MAX, (ptr<u8>)&dense[0], dense.reserve * sizeof(e_id));
+		}
+
+		// pages are owned, copies would free them twice
+		sparse_set(cref<sparse_set> other) = delete;
+		ref<sparse_set> operator=(cref<sparse_set> other) = delete;
+
+		sparse_set(fwd<sparse_set> other)
+		: pages(forward_data(other.pages))
+		, dense(forward_data(other.dense)) {}
+
+		ref<sparse_set> operator=(fwd<sparse_set> other) {
+			_release();
+			if (dense.data) dense.destroy();
+			pages = forward_data(other.pages);
+			dense = forward_data(other.dense);
+			return *this;
+		}
+
+		~sparse_set() {
+			_release();
 		}
 
-		~sparse_set() = default;
+		void _release() {
+			ptr<u32> null_page = sparse_null_page();
+			for (ptr<u32> page : pages) {
+				if (page == null_page) continue;
+				core::free256(page);
+			}
+
+			if (pages.data) pages.destroy();
+		}
 
 		u32 index(e_id e) const {
-			if (e.id() >= sparse.reserve) return U32_MAX;
-			return sparse[e.id()];
+			u32 page = e.id() >> SPARSE_PAGE_SHIFT;
+			if (page >= pages.size) return U32_MAX;
+			return pages[page][e.id() & SPARSE_PAGE_MASK];
 		}
 
-		void add(e_id e) {
-			if (e.id() >= sparse.reserve) {
-				u32 start = sparse.reserve;
-				sparse.resize(e.id());
-				u32 size = (sparse.reserve - start) * sizeof(u32);
-				core::set256(U32_MAX, (ptr<u8>)&sparse[start], size);
+		// entry must live in an allocated page
+		ref<u32> sparse(u32 id) const {
+			return pages[id >> SPARSE_PAGE_SHIFT][id & SPARSE_PAGE_MASK];
+		}
+
+		ref<u32> assure(u32 id) {
+			u32 page = id >> SPARSE_PAGE_SHIFT;
+			ptr<u32> null_page = sparse_null_page();
+			while (pages.size <= page) {
+				pages.add(null_page);
+			}
+
+			if (pages[page] == null_page) {
+				u32 bytes = SPARSE_PAGE_SIZE * sizeof(u32);
+				ptr<u32> data = (ptr<u32>)core::alloc256(bytes).data;
+				core::set256(U32_MAX, (ptr<u8>)data, bytes);
+				pages[page] = data;
 			}
 
-			sparse[e.id()] = dense.size;
+			return pages[page][id & SPARSE_PAGE_MASK];
+		}
+
+		void reserve(u32 count) {
+			u32 reserve = dense.reserve;
+			if (reserve >= dense.size + count) return;
+
+			dense.resize(dense.size + count);
+			core::set256(U32_MAX, (ptr<u8>)&dense[reserve], (dense.reserve - reserve) * sizeof(e_id));
+		}
+
+		void add(e_id e) {
+			assure(e.id()) = dense.size;
 
 			u32 reserve = dense.reserve;
 			e_id& entity = dense.add();
 			if (reserve != dense.reserve) {
-				core::set256(U32_MAX, (ptr<u8>)&dense[reserve], dense.reserve - reserve);
+				core::set256(U32_MAX, (ptr<u8>)&dense[reserve], (dense.reserve - reserve) * sizeof(e_id));
 			}
 
 			entity = e;
@@ -108,10 +203,10 @@ export namespace jolly {
 			dense.del(idx);
 			dense[dense.size]._id = U32_MAX;
 
-			sparse[e.id()] = U32_MAX;
+			sparse(e.id()) = U32_MAX;
 
 			if (dense[idx]._id != U32_MAX) {
-				sparse[dense[idx].id()] = idx;
+				sparse(dense[idx].id()) = idx;
 			}
 		}
 
@@ -119,7 +214,19 @@ export namespace jolly {
 			return index(e) != U32_MAX;
 		}
 
-		core::vector<u32> sparse;
+		// swap two dense slots, used by owning groups to pack their members
+		void swap(u32 a, u32 b) {
+			e_id ea = dense[a];
+			e_id eb = dense[b];
+
+			dense[a] = eb;
+			dense[b] = ea;
+
+			sparse(ea.id()) = b;
+			sparse(eb.id()) = a;
+		}
+
+		core::vector<ptr<u32>> pages;
 		core::vector<e_id> dense;
 	};
 
@@ -131,7 +238,12 @@ export namespace jolly {
 		pool()
 		: set()
 		, components(0)
-		, busy() {}
+		, added()
+		, changed()
+		, clock(nullptr)
+		, busy()
+		, owner(U64_MAX)
+		, version(0) {}
 
 		~pool() = default;
 
@@ -139,30 +251,192 @@ export namespace jolly {
 			JOLLY_ASSERT(!has(e), "entity already contains this component");
 			set.add(e);
 			components.add(item);
+			_stamp(1);
+			version++;
+		}
+
+		void add(e_id e, fwd<type> item) {
+			JOLLY_ASSERT(!has(e), "entity already contains this component");
+			set.add(e);
+			components.add(forward_data(item));
+			_stamp(1);
+			version++;
 		}
 
 		ref<type> add(e_id e) {
 			JOLLY_ASSERT(!has(e), "entity already contains this component");
 			set.add(e);
+			_stamp(1);
+			version++;
 			return components.add();
 		}
 
+		void reserve(u32 count) {
+			set.reserve(count);
+			if (components.reserve < components.size + count) {
+				components.resize(components.size + count);
+			}
+
+			if (tracked() && added.reserve < added.size + count) {
+				added.resize(added.size + count);
+				changed.resize(changed.size + count);
+			}
+		}
+
+		// change tracking is opt in, every component gets an added and a changed tick
+		// ticks are read from the ecs clock, see ecs::track
+		void track(cptr<u32> in) {
+			if (tracked()) return;
+			clock = in;
+			added = core::vector<u32>(components.reserve);
+			changed = core::vector<u32>(components.reserve);
+			_stamp(components.size);
+		}
+
+		bool tracked() const {
+			return clock != nullptr;
+		}
+
+		void _stamp(u32 count) {
+			if (!tracked()) return;
+			u32 tick = *clock;
+			for (u32 i : core::range(count)) {
+				added.add(tick);
+				changed.add(tick);
+			}
+		}
+
+		// copies items, trivially copyable components go in with a single block copy
+		void add_n(core::span<e_id> e, core::span<type> items) {
+			JOLLY_ASSERT(e.size == items.size, "entity and component counts differ");
+			reserve(e.size);
+			for (e_id entity : e) {
+				JOLLY_ASSERT(!has(entity), "entity already contains this component");
+				set.add(entity);
+			}
+
+			if constexpr (core::is_trivially_copyable_v<type>) {
+				core::copy8((ptr<u8>)items.data, (ptr<u8>)&components[components.size], e.size * sizeof(type));
+				components.size += e.size;
+			} else {
+				for (auto& item : items) {
+					components.add(item);
+				}
+			}
+
+			_stamp(e.size);
+			version++;
+		}
+
+		// every entity in e receives a copy of item
+		void fill_n(core::span<e_id> e, cref<type> item) {
+			reserve(e.size);
+			for (e_id entity : e) {
+				JOLLY_ASSERT(!has(entity), "entity already contains this component");
+				set.add(entity);
+				components.add(item);
+			}
+
+			_stamp(e.size);
+			version++;
+		}
+
 		void del(e_id e) {
 			JOLLY_ASSERT(has(e), "entity does not contain this component");
 			u32 index = set.index(e);
 			components.del(index);
 			set.del(e);
+
+			if (tracked()) {
+				added.del(index);
+				changed.del(index);
+			}
+
+			version++;
 		}
 
 		bool has(e_id e) const {
 			return set.has(e);
 		}
 
+		void swap(u32 a, u32 b) {
+			if (a == b) return;
+			set.swap(a, b);
+			core::swap8((ptr<u8>)&components[a], (ptr<u8>)&components[b], sizeof(type));
+
+			if (tracked()) {
+				core::swap8((ptr<u8>)&added[a], (ptr<u8>)&added[b], sizeof(u32));
+				core::swap8((ptr<u8>)&changed[a], (ptr<u8>)&changed[b], sizeof(u32));
+			}
+		}
+
+		// reorders the pool in bulk, cmp(a, b) is true when a should come before b
+		// the order is computed on indices first, then applied with one swap per element
+		template<typename Cmp>
+		void sort(Cmp cmp) {
+			JOLLY_ASSERT(owner == U64_MAX, "owned pools are ordered by their group");
+			u32 count = set.dense.size;
+			core::vector<u32> order(count);
+			core::vector<u32> scratch(count);
+			for (u32 i : core::range(count)) {
+				order.add(i);
+			}
+
+			auto less = [&](u32 a, u32 b) {
+				return cmp(components[a], components[b]);
+			};
+
+			core::merge_sort(order.data, scratch.data, count, less);
+			_permute(order);
+		}
+
+		// entities shared with other come first, in other's dense order
+		template<typename U>
+		void sort_as(cref<pool<U>> other) {
+			JOLLY_ASSERT(owner == U64_MAX, "owned pools are ordered by their group");
+			u32 pos = 0;
+			for (e_id e : other.set.dense) {
+				if (!has(e)) continue;
+				swap(set.index(e), pos++);
+			}
+		}
+
+		// order[i] is the current index of the item that ends up at i
+		void _permute(cref<core::vector<u32>> order) {
+			u32 count = order.size;
+			core::vector<u32> where(count); // current index of the item that started at i
+			core::vector<u32> at(count);    // starting index of the item currently at i
+			for (u32 i : core::range(count)) {
+				where.add(i);
+				at.add(i);
+			}
+
+			for (u32 i : core::range(count)) {
+				u32 src = where[order[i]];
+				if (src == i) continue;
+
+				swap(i, src);
+				u32 displaced = at[i];
+				where[displaced] = src;
+				at[src] = displaced;
+				where[order[i]] = i;
+				at[i] = order[i];
+			}
+		}
+
 		ref<T> get(e_id e) const {
 			JOLLY_ASSERT(has(e), "entity does not contain this component");
 			return components[set.index(e)];
 		}
 
+		// mutable access that marks the component as changed, needs a wview of the pool
+		ref<T> patch(e_id e) {
+			JOLLY_ASSERT(has(e), "entity does not contain this component");
+			u32 idx = set.index(e);
+			if (tracked()) changed[idx] = *clock;
+			return components[idx];
+		}
+
 		cref<core::rwlock> get_lock() const {
 			return busy;
 		}
@@ -190,9 +464,86 @@ export namespace jolly {
 
 		sparse_set set;
 		core::vector<type> components;
+		core::vector<u32> added;
+		core::vector<u32> changed;
+		cptr<u32> clock;
 		core::rwlock busy;
+		u64 owner; // index of the owning group, if any
+		u32 version; // bumped whenever an entity joins or leaves the pool
+	};
+
+	// filters for tracked pools, select components stamped after a given tick
+	template <typename T>
+	struct added {
+		using type = T;
+		static cref<core::vector<u32>> ticks(cref<pool<T>> p) {
+			return p.added;
+		}
+	};
 
-		static inline u64 index = U64_MAX;
+	template <typename T>
+	struct changed {
+		using type = T;
+		static cref<core::vector<u32>> ticks(cref<pool<T>> p) {
+			return p.changed;
+		}
+	};
+
+	template <typename Filter>
+	struct tick_view {
+		using type = typename Filter::type;
+		using this_type = tick_view<Filter>;
+		using pool_type = pool<type>;
+
+		tick_view(cref<pool_type> in, u32 tick)
+		: data(in), since(tick) {}
+
+		struct iterator {
+			using pair_type = core::pair<e_id, core::wref<type>>;
+
+			iterator(cref<this_type> in, u32 idx)
+			: view(in), index(idx) {
+				skip();
+			}
+
+			// stop at the next component stamped after since
+			void skip() {
+				auto& ticks = Filter::ticks(view.data);
+				u32 size = view.data.set.dense.size;
+				while (index < size && ticks[index] <= view.since) {
+					index++;
+				}
+			}
+
+			ref<iterator> operator++() {
+				index++;
+				skip();
+				return *this;
+			}
+
+			bool operator!=(cref<iterator> other) const {
+				return index != other.index;
+			}
+
+			pair_type operator*() const {
+				return pair_type(view.data.set.dense[index], view.data.components[index]);
+			}
+
+			cref<this_type> view;
+			u32 index;
+		};
+
+		auto begin() const {
+			JOLLY_ASSERT(data.tracked(), "pool is not tracked, call ecs::track first");
+			return iterator(*this, 0);
+		}
+
+		auto end() const {
+			return iterator(*this, data.set.dense.size);
+		}
+
+		cref<pool_type> data;
+		u32 since;
 	};
 
 	struct ecs;
@@ -228,9 +579,10 @@ export namespace jolly {
 			return set.index(e) != U32_MAX;
 		}
 
+		// the group's view already holds every pool lock, so pools are read directly
 		tuple_type get(e_id e) const {
 			JOLLY_ASSERT(has(e), "entity does not contain this component");
-			return tuple_type(state.get<Ts>(e)...);
+			return tuple_type(state.view<Ts>().get(e)...);
 		}
 
 		cref<core::rwlock> get_lock() const {
@@ -263,164 +615,963 @@ export namespace jolly {
 		ref<ecs> state;
 		core::rwlock busy;
 
-		static inline u64 index = U64_MAX;
-		static u64 bitset() {
-			return ((1 << pool<Ts>::index) | ...);
+		u64 bitset() const {
+			return (state.bit<Ts>() | ...);
 		}
 	};
 
-	enum class ecs_event {
-		create = 0,
-		destroy,
-		add,
-		del,
-
-		max_event_size
-	};
+	// owning groups take over the dense order of every pool in Ts, members are packed into
+	// [0, size) of each owned pool so iteration is a linear walk without sparse lookups
+	// pool addresses are stable for the lifetime of the ecs, so caching them here is fine
+	// a pool can only be owned by one group
+	template <typename... Ts>
+	struct owning_group {
+		using this_type = owning_group<Ts...>;
+		using tuple_type = core::tuple<core::wref<Ts>...>;
+		using pools_type = core::tuple<ptr<pool<Ts>>...>;
+		using sequence_type = core::index_sequential<sizeof...(Ts)>;
 
-	typedef void (*pfn_ecs_cb)(ref<ecs> state, e_id e, ecs_event event);
+		owning_group(ref<ecs> in)
+		: pools(&in.view<Ts>()...)
+		, state(in)
+		, size(0)
+		, busy() {}
 
-	// DO NOT ACCESS DIRECTLY, obtain a rview/wview
-	struct ecs {
-		static constexpr u32 MAX_POOLS = core::BLOCK_64;
+		~owning_group() = default;
 
-		ecs()
-		: entities(0)
-		, bitset(0)
-		, pools(0)
-		, groups(0)
-		, callbacks((u32)ecs_event::max_event_size)
-		, busy()
-		, free(U32_MAX) {
+		// swap e to the back of the packed range in every owned pool
+		void add(e_id e) {
+			JOLLY_ASSERT(!has(e), "entity already belongs to this group");
+			_swap(e, size, sequence_type{});
+			size++;
+		}
 
+		void del(e_id e) {
+			JOLLY_ASSERT(has(e), "entity does not belong to this group");
+			size--;
+			_swap(e, size, sequence_type{});
 		}
 
-		~ecs() {
-			// consider calling destroy callbacks for all entities
+		bool has(e_id e) const {
+			return pools.get<0>()->set.index(e) < size;
 		}
 
-		e_id create() {
-			e_id entity{U32_MAX};
-			if (free == U32_MAX) {
-				u32 id = entities.size;
+		tuple_type get(e_id e) const {
+			JOLLY_ASSERT(has(e), "entity does not belong to this group");
+			return at(pools.get<0>()->set.index(e), sequence_type{});
+		}
 
-				e_id& e = entities.add();
-				bitset.add();
+		template<u32... Indices>
+		tuple_type at(u32 idx, core::index_sequence<Indices...>) const {
+			return tuple_type(core::wref<Ts>(pools.get<Indices>()->components[idx])...);
+		}
 
-				e._id = id; // generation = 0
-				entity = e;
-			} else {
-				u32 id = free;
-				e_id& e = entities[free];
-				free = e.id() == (U32_MAX & e_id::id_mask) ? U32_MAX : e.id();
-				e._id = ((e.gen() + 1) % U8_MAX) << 24 | id;
-				entity = e;
-			}
+		template<u32... Indices>
+		void _swap(e_id e, u32 idx, core::index_sequence<Indices...>) {
+			auto helper = [](auto p, e_id e, u32 idx) {
+				p->swap(p->set.index(e), idx);
+				return 0;
+			};
 
-			callback(entity, ecs_event::create);
-			return entity;
+			(helper(pools.get<Indices>(), e, idx), ...);
 		}
 
-		void destroy(e_id e) {
-			callback(e, ecs_event::destroy);
-			entities[e.id()]._id = (e.gen() << 24) | (free & e_id::id_mask);
-			bitset[e.id()] = 0;
-			free = e.id();
+		cref<core::rwlock> get_lock() const {
+			return busy;
 		}
 
-		void callback(e_id e, ecs_event event) {
-			for (auto cb : callbacks[(u32)event]) {
-				cb(*this, e, event);
-			}
-		}
+		struct iterator: public impl_ecs::iterator<this_type> {
+			using parent_type = impl_ecs::iterator<this_type>;
+			using pair_type = core::pair<e_id, tuple_type>;
 
-		void add_cb(ecs_event event, pfn_ecs_cb cb) {
-			auto& vec = callbacks[(u32)event];
-			if (!vec.data) {
-				vec = core::vector<pfn_ecs_cb>(0);
+			using parent_type::parent_type;
+
+			pair_type operator*() const {
+				u32 index = parent_type::index;
+				auto& data = parent_type::data;
+				e_id id = data.pools.get<0>()->set.dense[index];
+				return pair_type(id, data.at(index, sequence_type{}));
 			}
+		};
 
-			vec.add(forward_data(cb));
+		auto begin() const {
+			return iterator(*this, 0);
 		}
 
-		template<typename T>
-		void register_pool() {
-			JOLLY_ASSERT(pools.size < MAX_POOLS, "max pool size reached");
-			pool<T>::index = pools.size;
-			auto& p = pools.add();
-			p = core::mem_create<pool<T>>();
+		auto end() const {
+			return iterator(*this, size);
+		}
 
-			auto destroy_cb = [](ref<ecs> state, e_id e, ecs_event event) {
-				auto& pool = state.view<T>();
-				pool.del(e);
-			};
+		pools_type pools;
+		ref<ecs> state;
+		u32 size;
+		core::rwlock busy;
 
-			add_cb(ecs_event::destroy, destroy_cb);
+		u64 bitset() const {
+			return (state.bit<Ts>() | ...);
 		}
+	};
 
-		template<typename... Ts>
-		void register_group() {
-			jolly::group<Ts...>::index = groups.size;
-			auto& group_info = groups.add();
-			group_info.one = core::mem_create<jolly::group<Ts...>>(*this);
-			group_info.two = jolly::group<Ts...>::bitset();
-			auto& g = group_info.one.get<jolly::group<Ts...>>();
+	template <typename... Ts>
+	struct with {};
 
-			for (u32 i : core::range(bitset.size)) {
-				if ((bitset[i] & group_info.two) == group_info.two) {
-					g.add(entities[i]);
-				}
-			}
+	template <typename... Ts>
+	struct without {};
 
-			auto entity_add_cb = [](ref<ecs> state, e_id e, ecs_event event) {
-				u64 bits = state.groups[(u32)jolly::group<Ts...>::index].two;
-				if ((state.bitset[e.id()] & bits) == bits) {
-					auto g = core::wview_create(state.group<Ts...>());
-					g->add(e);
-				}
-			};
+	template <typename With, typename Without = without<>>
+	struct query;
 
-			auto entity_del_cb = [](ref<ecs> state, e_id e, ecs_event event) {
-				auto& g = state.group<Ts...>();
-				u64 bits = state.groups[(u32)jolly::group<Ts...>::index].two;
-				if (g.has(e) && (state.bitset[e.id()] & bits) != bits) {
-					auto g = core::wview_create(state.group<Ts...>());
-					g->del(e);
-				}
-			};
+	// ad hoc alternative to groups, nothing is registered with the ecs's observers
+	// matches are rebuilt lazily by walking the smallest pool in With and testing signatures,
+	// the result is cached until one of the involved pools gains or loses an entity
+	template <typename... Ts, typename... Xs>
+	struct query<with<Ts...>, without<Xs...>> {
+		using this_type = query<with<Ts...>, without<Xs...>>;
+		using tuple_type = core::tuple<core::wref<Ts>...>;
+		using pools_type = core::tuple<ptr<pool<Ts>>...>;
+		using sequence_type = core::index_sequential<sizeof...(Ts)>;
 
-			add_cb(ecs_event::add, entity_add_cb);
-			add_cb(ecs_event::del, entity_del_cb);
+		static constexpr u32 VERSION_COUNT = sizeof...(Ts) + sizeof...(Xs);
+
+		query(ref<ecs> in)
+		: pools(&in.view<Ts>()...)
+		, state(in)
+		, matches(0)
+		, versions()
+		, valid(false)
+		, include(0)
+		, exclude(0)
+		, busy() {
+			(in.view<Xs>(), ...);
+			include = (in.bit<Ts>() | ...);
+			exclude = (in.bit<Xs>() | ... | 0);
 		}
 
-		// we do not provide direct access to pool's other add overload as we can't guarantee atomicity
-		template<typename T>
-		void add(e_id e, T&& item) {
-			{
-				auto pool = core::wview_create(view<T>());
-				pool->add(e, forward_data(item));
+		~query() = default;
+
+		// structural changes go through an ecs wview, so callers holding an ecs view
+		// only race with each other here
+		void refresh() {
+			core::lock lock(busy.write());
+
+			u32 versions_now[VERSION_COUNT] = { state.view<Ts>().version..., state.view<Xs>().version... };
+			bool dirty = !valid;
+			for (u32 i : core::range(VERSION_COUNT)) {
+				dirty |= versions[i] != versions_now[i];
+				versions[i] = versions_now[i];
 			}
 
-			u64 bits = (u64)1 << pool<T>::index;
-			bitset[e.id()] |= bits;
-			callback(e, ecs_event::add);
+			if (!dirty) return;
+			_rebuild();
+			valid = true;
 		}
 
-		template<typename T>
-		void add(e_id e, cref<T> item) {
-			add(e, forward_data(core::copy(item)));
-		}
+		void _rebuild() {
+			cptr<sparse_set> driver = nullptr;
+			auto smallest = [&](cref<sparse_set> set) {
+				if (!driver || set.dense.size < driver->dense.size) driver = &set;
+				return 0;
+			};
+			(smallest(state.view<Ts>().set), ...);
 
-		template<typename T>
-		void del(e_id e) {
-			{
-				auto pool = core::wview_create(view<T>());
-				pool->del(e);
+			u32 count = driver->dense.size;
+			if (matches.reserve < count) {
+				matches.resize(count);
 			}
 
-			u64 bits = (u64)1 << pool<T>::index;
-			bitset[e.id()] &= ~bits;
-			callback(e, ecs_event::del);
+			matches.size = core::filter64(state.bitset.data, (cptr<u32>)driver->dense.data, e_id::id_mask,
+				count, include | exclude, include, (ptr<u32>)matches.data);
+		}
+
+		// tests the live signature, matches agree with it after a refresh
+		bool has(e_id e) const {
+			return (state.bitset[e.id()] & (include | exclude)) == include;
+		}
+
+		tuple_type get(e_id e) const {
+			return at(e, sequence_type{});
+		}
+
+		template<u32... Indices>
+		tuple_type at(e_id e, core::index_sequence<Indices...>) const {
+			auto helper = [](auto p, e_id e) -> auto& {
+				return p->components[p->set.index(e)];
+			};
+
+			return tuple_type(core::wref<Ts>(helper(pools.get<Indices>(), e))...);
+		}
+
+		cref<core::rwlock> get_lock() const {
+			return busy;
+		}
+
+		struct iterator: public impl_ecs::iterator<this_type> {
+			using parent_type = impl_ecs::iterator<this_type>;
+			using pair_type = core::pair<e_id, tuple_type>;
+
+			using parent_type::parent_type;
+
+			pair_type operator*() const {
+				u32 index = parent_type::index;
+				auto& data = parent_type::data;
+				e_id id = data.matches[index];
+				return pair_type(id, data.get(id));
+			}
+		};
+
+		auto begin() const {
+			return iterator(*this, 0);
+		}
+
+		auto end() const {
+			return iterator(*this, matches.size);
+		}
+
+		pools_type pools;
+		ref<ecs> state;
+		core::vector<e_id> matches;
+		u32 versions[VERSION_COUNT];
+		bool valid;
+		u64 include;
+		u64 exclude;
+		core::rwlock busy;
+	};
+
+	enum class ecs_event {
+		create = 0,
+		destroy,
+		add,
+		del,
+
+		max_event_size
+	};
+
+	// callbacks are delivered in batches, single entity operations pass a count of 1
+	typedef void (*pfn_ecs_cb)(ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event);
+	typedef void (*pfn_ecs_observer)(ptr<void> user, ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event);
+
+	// observers only receive entities that hold every component in mask
+	// for del events the mask is tested against the signature before the removal
+	struct ecs_observer {
+		pfn_ecs_observer fn;
+		ptr<void> user;
+		u64 mask;
+		u32 id; // one per observe call, shared by the copies stored on each pool
+	};
+
+	// add/del observers registered on a single pool
+	struct pool_signals {
+		core::vector<ecs_observer> add;
+		core::vector<ecs_observer> del;
+	};
+
+	enum class ecs_op : u32 {
+		create = 0,
+		destroy,
+		add,
+		del,
+	};
+
+	struct ecs_command;
+	typedef void (*pfn_ecs_playback)(ref<ecs> state, cptr<ecs_command> cmds, u32 count, ptr<u8> payload);
+	typedef void (*pfn_ecs_drop)(ptr<u8> data);
+
+	struct ecs_command_ops {
+		pfn_ecs_playback playback;
+		pfn_ecs_drop drop;
+	};
+
+	template <typename T>
+	void ecs_playback(ref<ecs> state, cptr<ecs_command> cmds, u32 count, ptr<u8> payload);
+
+	template <typename T>
+	void ecs_drop(ptr<u8> data) {
+		core::destroy((ptr<T>)data);
+	}
+
+	template <typename T>
+	inline ecs_command_ops ecs_command_ops_v = { ecs_playback<T>, ecs_drop<T> };
+
+	struct ecs_command {
+		ecs_op op;
+		e_id entity;
+		u32 payload; // offset into the command buffer's payload
+		cptr<ecs_command_ops> ops;
+	};
+
+	// records structural changes without touching the ecs, buffers are owned by a single thread
+	// and handed to ecs::submit, everything is replayed in batches at the next ecs::flush
+	struct ecs_commands {
+		ecs_commands()
+		: commands(0)
+		, payload(0)
+		, created(0) {}
+
+		ecs_commands(fwd<ecs_commands> other)
+		: commands()
+		, payload()
+		, created(0) {
+			*this = forward_data(other);
+		}
+
+		~ecs_commands() {
+			clear();
+		}
+
+		ref<ecs_commands> operator=(fwd<ecs_commands> other) {
+			clear();
+			if (commands.data) commands.destroy();
+			if (payload.data) payload.destroy();
+
+			commands = forward_data(other.commands);
+			payload = forward_data(other.payload);
+			created = other.created;
+			other.created = 0;
+			return *this;
+		}
+
+		// returns a placeholder, it can be used with this buffer only
+		e_id create() {
+			e_id e{ (e_id::pending_gen << 24) | created++ };
+			commands.add(ecs_command{ ecs_op::create, e, 0, nullptr });
+			return e;
+		}
+
+		void destroy(e_id e) {
+			commands.add(ecs_command{ ecs_op::destroy, e, 0, nullptr });
+		}
+
+		// lvalues deduce T as a reference, the queued component is always the plain type
+		template<typename T>
+		void add(e_id e, T&& item) {
+			using type = core::raw_type_t<T>;
+			u32 offset = _allocate(sizeof(type), alignof(type));
+			new (&payload[offset]) type(forward_data(item));
+			commands.add(ecs_command{ ecs_op::add, e, offset, &ecs_command_ops_v<type> });
+		}
+
+		template<typename T>
+		void add(e_id e, cref<T> item) {
+			add(e, forward_data(core::copy(item)));
+		}
+
+		template<typename T>
+		void del(e_id e) {
+			commands.add(ecs_command{ ecs_op::del, e, 0, &ecs_command_ops_v<T> });
+		}
+
+		// drops everything that has not been played back
+		void clear() {
+			if (!commands.data) return;
+			for (auto& cmd : commands) {
+				if (cmd.op != ecs_op::add) continue;
+				cmd.ops->drop(&payload[cmd.payload]);
+			}
+
+			commands.size = 0;
+			payload.size = 0;
+			created = 0;
+		}
+
+		u32 _allocate(u32 bytes, u32 align) {
+			u32 offset = (payload.size + align - 1) & ~(align - 1);
+			if (payload.reserve < offset + bytes) {
+				payload.resize(core::max<u32>(payload.reserve * 2, offset + bytes));
+			}
+
+			payload.size = offset + bytes;
+			return offset;
+		}
+
+		core::vector<ecs_command> commands;
+		core::vector<u8> payload;
+		u32 created;
+	};
+
+	// type erased operations on a pool, indexed by the pool's slot
+	typedef void (*pfn_pool_clone)(ref<ecs> state, e_id src, core::span<e_id> dst);
+	typedef void (*pfn_pool_del)(ref<ecs> state, core::span<e_id> e);
+
+	struct pool_ops {
+		pfn_pool_clone clone;
+		pfn_pool_del del;
+	};
+
+	// incremental sort_as between two pools, advanced a bounded number of entities per call
+	struct pool_compaction;
+	typedef u32 (*pfn_pool_compact)(ref<ecs> state, ref<pool_compaction> job, u32 budget);
+
+	struct pool_compaction {
+		pfn_pool_compact step;
+		u32 cursor; // index into the leading pool's dense array
+		u32 pos; // entries of the following pool already in place
+		u32 versions[2]; // a pass restarts when either pool gains or loses entities
+	};
+
+	// DO NOT ACCESS DIRECTLY, obtain a rview/wview
+	struct ecs {
+		static constexpr u32 MAX_POOLS = core::BLOCK_64;
+		static constexpr u32 COMPACT_BUDGET = core::BLOCK_4096; // entities visited per compact call
+
+		ecs()
+		: entities(0)
+		, bitset(0)
+		, slots(0)
+		, pools(0)
+		, ops(0)
+		, signals(0)
+		, groups(0)
+		, queries(0)
+		, compactions(0)
+		, callbacks((u32)ecs_event::max_event_size)
+		, pending(0)
+		, pending_lock()
+		, busy()
+		, free(U32_MAX)
+		, tick(1)
+		, observers(0) {
+
+		}
+
+		~ecs() {
+			// consider calling destroy callbacks for all entities
+		}
+
+		e_id _create() {
+			e_id entity{U32_MAX};
+			if (free == U32_MAX) {
+				u32 id = entities.size;
+
+				e_id& e = entities.add();
+				bitset.add();
+
+				e._id = id; // generation = 0
+				entity = e;
+			} else {
+				u32 id = free;
+				e_id& e = entities[free];
+				free = e.id() == (U32_MAX & e_id::id_mask) ? U32_MAX : e.id();
+				e._id = ((e.gen() + 1) % U8_MAX) << 24 | id;
+				entity = e;
+			}
+
+			return entity;
+		}
+
+		void _release(e_id e) {
+			entities[e.id()]._id = (e.gen() << 24) | (free & e_id::id_mask);
+			bitset[e.id()] = 0;
+			free = e.id();
+		}
+
+		e_id create() {
+			e_id entity = _create();
+			callback(entity, ecs_event::create);
+			return entity;
+		}
+
+		void destroy(e_id e) {
+			callback(e, ecs_event::destroy);
+			_destroy_components(&e, 1);
+			_release(e);
+		}
+
+		// recycles free ids first, storage for the rest is reserved once
+		void create_n(core::span<e_id> out) {
+			u32 count = 0;
+			while (count < out.size && free != U32_MAX) {
+				out[count++] = _create();
+			}
+
+			u32 rem = out.size - count;
+			if (entities.reserve < entities.size + rem) {
+				entities.resize(entities.size + rem);
+			}
+
+			if (bitset.reserve < entities.reserve) {
+				bitset.resize(entities.reserve);
+			}
+
+			for (u32 i : core::range(count, out.size)) {
+				out[i] = _create();
+			}
+
+			callback(out.data, out.size, ecs_event::create);
+		}
+
+		core::vector<e_id> create_n(u32 count) {
+			core::vector<e_id> out(count);
+			out.size = count;
+			create_n(out);
+			return out;
+		}
+
+		// pools drop their components in one batch each
+		void destroy_n(core::span<e_id> e) {
+			callback(e.data, e.size, ecs_event::destroy);
+			_destroy_components(e.data, e.size);
+			for (e_id entity : e) {
+				_release(entity);
+			}
+		}
+
+		// only pools that appear in a signature are visited, each gets a single del batch
+		void _destroy_components(cptr<e_id> e, u32 count) {
+			u64 present = 0;
+			for (u32 i : core::range(count)) {
+				present |= bitset[e[i].id()];
+			}
+
+			if (count == 1) {
+				for (u32 i : core::range(pools.size)) {
+					if (!(present & ((u64)1 << i))) continue;
+					ops[i].del(*this, core::span<e_id>((ptr<e_id>)e, 1));
+				}
+
+				return;
+			}
+
+			core::vector<e_id> owned(count);
+			for (u32 i : core::range(pools.size)) {
+				u64 bit = (u64)1 << i;
+				if (!(present & bit)) continue;
+
+				owned.size = 0;
+				for (u32 j : core::range(count)) {
+					if (bitset[e[j].id()] & bit) owned.add(e[j]);
+				}
+
+				ops[i].del(*this, owned);
+			}
+		}
+
+		// out receives new entities that each hold a copy of every component of src
+		void clone_n(e_id src, core::span<e_id> out) {
+			create_n(out);
+
+			u64 bits = bitset[src.id()];
+			for (u32 i : core::range(pools.size)) {
+				if (!(bits & ((u64)1 << i))) continue;
+				ops[i].clone(*this, src, out);
+			}
+
+			for (e_id entity : out) {
+				bitset[entity.id()] = bits;
+			}
+
+			notify(bits, out.data, out.size, ecs_event::add);
+		}
+
+		// unfiltered callbacks, fired for every entity of every event
+		void callback(cptr<e_id> e, u32 count, ecs_event event) {
+			if (!count) return;
+			for (auto cb : callbacks[(u32)event]) {
+				cb(*this, e, count, event);
+			}
+		}
+
+		void callback(e_id e, ecs_event event) {
+			callback(&e, 1, event);
+		}
+
+		void add_cb(ecs_event event, pfn_ecs_cb cb) {
+			auto& vec = callbacks[(u32)event];
+			if (!vec.data) {
+				vec = core::vector<pfn_ecs_cb>(0);
+			}
+
+			vec.add(forward_data(cb));
+		}
+
+		// add/del observer for entities holding all of Ts, it is stored on each pool in Ts
+		// so changes to unrelated pools never reach it, returns the id taken by unobserve
+		template<typename... Ts>
+		u32 observe(ecs_event event, pfn_ecs_observer fn, ptr<void> user) {
+			JOLLY_ASSERT(event == ecs_event::add || event == ecs_event::del, "only add and del can be filtered");
+			(view<Ts>(), ...);
+			u64 mask = (bit<Ts>() | ...);
+
+			auto helper = [](ref<ecs> state, ecs_event event, ecs_observer observer, u64 index) {
+				auto& sig = state.signals[(u32)index];
+				auto& vec = event == ecs_event::add ? sig.add : sig.del;
+				vec.add(observer);
+				return 0;
+			};
+
+			ecs_observer observer{ fn, user, mask, observers++ };
+			(helper(*this, event, observer, slot<pool<Ts>>()), ...);
+			return observer.id;
+		}
+
+		template<typename... Ts>
+		u32 observe(ecs_event event, pfn_ecs_cb cb) {
+			auto plain = [](ptr<void> user, ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event) {
+				((pfn_ecs_cb)user)(state, e, count, event);
+			};
+
+			return observe<Ts...>(event, plain, (ptr<void>)cb);
+		}
+
+		// observers holding a user pointer remove themselves before it goes away
+		void unobserve(u32 id) {
+			auto drop = [&](ref<core::vector<ecs_observer>> vec) {
+				u32 kept = 0;
+				for (u32 i : core::range(vec.size)) {
+					if (vec[i].id != id) vec[kept++] = vec[i];
+				}
+
+				vec.size = kept;
+			};
+
+			for (auto& sig : signals) {
+				drop(sig.add);
+				drop(sig.del);
+			}
+		}
+
+		// bits are the pools that changed, an observer on several changed pools runs once
+		void notify(u64 bits, cptr<e_id> e, u32 count, ecs_event event) {
+			if (!count) return;
+			callback(e, count, event);
+
+			bool del = event == ecs_event::del;
+			u64 removed = del ? bits : 0;
+			core::vector<e_id> filtered = core::vector<e_id>();
+
+			for (u32 i : core::range(signals.size)) {
+				if (!(bits & ((u64)1 << i))) continue;
+				auto& vec = del ? signals[i].del : signals[i].add;
+				for (auto& observer : vec) {
+					if (_notified(bits, i, observer, del)) continue;
+					_deliver(observer, e, count, removed, event, filtered);
+				}
+			}
+		}
+
+		// true if observer is registered on a changed pool before pool idx
+		bool _notified(u64 bits, u32 idx, cref<ecs_observer> observer, bool del) const {
+			for (u32 i : core::range(idx)) {
+				if (!(bits & ((u64)1 << i))) continue;
+				auto& vec = del ? signals[i].del : signals[i].add;
+				for (auto& other : vec) {
+					if (other.id == observer.id) return true;
+				}
+			}
+
+			return false;
+		}
+
+		void _deliver(cref<ecs_observer> observer, cptr<e_id> e, u32 count, u64 removed, ecs_event event, ref<core::vector<e_id>> scratch) {
+			auto match = [&](e_id entity) {
+				u64 signature = bitset[entity.id()] | removed;
+				return (signature & observer.mask) == observer.mask;
+			};
+
+			if (count == 1) {
+				if (match(e[0])) observer.fn(observer.user, *this, e, 1, event);
+				return;
+			}
+
+			if (!scratch.data) {
+				scratch = core::vector<e_id>(count);
+			}
+
+			scratch.size = 0;
+			for (u32 i : core::range(count)) {
+				if (match(e[i])) scratch.add(e[i]);
+			}
+
+			if (scratch.size) observer.fn(observer.user, *this, scratch.data, scratch.size, event);
+		}
+
+		template<typename T>
+		void register_pool() {
+			JOLLY_ASSERT(pools.size < MAX_POOLS, "max pool size reached");
+			_bind<pool<T>>(pools.size);
+			auto& p = pools.add();
+			p = core::mem_create<pool<T>>();
+
+			// signature bits and callbacks are handled by the caller
+			auto clone = [](ref<ecs> state, e_id src, core::span<e_id> dst) {
+				auto pool = core::wview_create(state.view<T>());
+				pool->reserve(dst.size);
+				pool->fill_n(dst, pool->get(src));
+			};
+
+			// go through a del batch so observers see the removal
+			auto del = [](ref<ecs> state, core::span<e_id> e) {
+				state._del_batch<T>(e.data, e.size);
+			};
+
+			ops.add(pool_ops{ clone, del });
+			signals.add(pool_signals{ core::vector<ecs_observer>(0), core::vector<ecs_observer>(0) });
+		}
+
+		template<typename... Ts>
+		void register_group() {
+			(view<Ts>(), ...);
+			_bind<jolly::group<Ts...>>(groups.size);
+			auto& group_info = groups.add();
+			group_info.one = core::mem_create<jolly::group<Ts...>>(*this);
+			auto& g = group_info.one.get<jolly::group<Ts...>>();
+			group_info.two = g.bitset();
+
+			for (u32 i : core::range(bitset.size)) {
+				if ((bitset[i] & group_info.two) == group_info.two) {
+					g.add(entities[i]);
+				}
+			}
+
+			// observers only see entities that hold (or held, for del) all of Ts
+			auto entity_add_cb = [](ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event) {
+				auto& g = state.group<Ts...>();
+				auto match = [&](e_id e) {
+					return !g.has(e);
+				};
+
+				state._batch_update(g, e, count, match, [](auto& view, e_id e) { view->add(e); });
+			};
+
+			auto entity_del_cb = [](ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event) {
+				auto& g = state.group<Ts...>();
+				auto match = [&](e_id e) {
+					return g.has(e);
+				};
+
+				state._batch_update(g, e, count, match, [](auto& view, e_id e) { view->del(e); });
+			};
+
+			observe<Ts...>(ecs_event::add, entity_add_cb);
+			observe<Ts...>(ecs_event::del, entity_del_cb);
+		}
+
+		template<typename... Ts>
+		void register_owning_group() {
+			(view<Ts>(), ...);
+			u64 idx = groups.size;
+			auto claim = [](u64 idx, auto& p) {
+				JOLLY_ASSERT(p.owner == U64_MAX, "pool is already owned by another group");
+				p.owner = idx;
+				return 0;
+			};
+
+			(claim(idx, view<Ts>()), ...);
+
+			_bind<jolly::owning_group<Ts...>>((u32)idx);
+			auto& group_info = groups.add();
+			group_info.one = core::mem_create<jolly::owning_group<Ts...>>(*this);
+			auto& g = group_info.one.get<jolly::owning_group<Ts...>>();
+			group_info.two = g.bitset();
+
+			for (u32 i : core::range(bitset.size)) {
+				if ((bitset[i] & group_info.two) == group_info.two) {
+					g.add(entities[i]);
+				}
+			}
+
+			// observers only see entities that hold (or held, for del) all of Ts
+			auto entity_add_cb = [](ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event) {
+				auto& g = state.owning_group<Ts...>();
+				auto match = [&](e_id e) {
+					return !g.has(e);
+				};
+
+				state._batch_update(g, e, count, match, [](auto& view, e_id e) { view->add(e); });
+			};
+
+			// del callbacks run before the component leaves its pool
+			auto entity_del_cb = [](ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event) {
+				auto& g = state.owning_group<Ts...>();
+				auto match = [&](e_id e) {
+					return g.has(e);
+				};
+
+				state._batch_update(g, e, count, match, [](auto& view, e_id e) { view->del(e); });
+			};
+
+			observe<Ts...>(ecs_event::add, entity_add_cb);
+			observe<Ts...>(ecs_event::del, entity_del_cb);
+		}
+
+		// only lock the group once a matching entity is found, most batches touch no group at all
+		template<typename G, typename Match, typename Fn>
+		void _batch_update(ref<G> g, cptr<e_id> e, u32 count, Match match, Fn fn) {
+			u32 first = 0;
+			while (first < count && !match(e[first])) first++;
+			if (first == count) return;
+
+			auto view = core::wview_create(g);
+			for (u32 i : core::range(first, count)) {
+				if (match(e[i])) fn(view, e[i]);
+			}
+		}
+
+		// batched structural changes, one pool lock and one callback per batch
+		// fn(i) yields the component to move into the pool for e[i]
+		template<typename T, typename Fn>
+		void _add_batch(cptr<e_id> e, u32 count, Fn fn) {
+			if (!count) return;
+			auto& p = view<T>();
+			{
+				auto pool = core::wview_create(p);
+				pool->reserve(count);
+				for (u32 i : core::range(count)) {
+					pool->add(e[i], fn(i));
+				}
+			}
+
+			u64 bits = bit<T>();
+			for (u32 i : core::range(count)) {
+				bitset[e[i].id()] |= bits;
+			}
+
+			notify(bits, e, count, ecs_event::add);
+		}
+
+		template<typename T>
+		void _del_batch(cptr<e_id> e, u32 count) {
+			if (!count) return;
+			u64 bits = bit<T>();
+			for (u32 i : core::range(count)) {
+				bitset[e[i].id()] &= ~bits;
+			}
+
+			notify(bits, e, count, ecs_event::del);
+
+			auto pool = core::wview_create(view<T>());
+			for (u32 i : core::range(count)) {
+				pool->del(e[i]);
+			}
+		}
+
+		template<typename T>
+		void add_n(core::span<e_id> e, core::span<T> items) {
+			auto& p = view<T>();
+			{
+				auto pool = core::wview_create(p);
+				pool->add_n(e, items);
+			}
+
+			u64 bits = bit<T>();
+			for (e_id entity : e) {
+				bitset[entity.id()] |= bits;
+			}
+
+			notify(bits, e.data, e.size, ecs_event::add);
+		}
+
+		template<typename T>
+		void del_n(core::span<e_id> e) {
+			_del_batch<T>(e.data, e.size);
+		}
+
+		// thread safe, buffers are replayed in submission order at the next flush
+		void submit(fwd<ecs_commands> cmds) {
+			core::lock lock(pending_lock);
+			pending.add(forward_data(cmds));
+		}
+
+		// sync point for deferred structural changes, call with a write view
+		void flush() {
+			core::vector<ecs_commands> buffers;
+			{
+				core::lock lock(pending_lock);
+				buffers = forward_data(pending);
+				pending = core::vector<ecs_commands>(0);
+			}
+
+			for (auto& cmds : buffers) {
+				playback(cmds);
+			}
+		}
+
+		// creates run first so placeholders can be resolved, component commands are bucketed by
+		// type keeping their recorded order and each bucket is applied as one batch, destroys run last
+		void playback(ref<ecs_commands> cmds) {
+			core::vector<e_id> created = create_n(cmds.created);
+			core::vector<e_id> destroyed(0);
+			core::vector<cptr<ecs_command_ops>> types(0);
+			core::vector<u32> counts(0);
+
+			auto resolve = [&](e_id e) {
+				return e.pending() ? created[e.id()] : e;
+			};
+
+			for (auto& cmd : cmds.commands) {
+				cmd.entity = resolve(cmd.entity);
+				if (cmd.op == ecs_op::destroy) {
+					destroyed.add(cmd.entity);
+				}
+
+				if (!cmd.ops) continue;
+				u32 bucket = types.find(cmd.ops);
+				if (bucket == U32_MAX) {
+					bucket = types.size;
+					types.add(cmd.ops);
+					counts.add(0);
+				}
+
+				counts[bucket]++;
+			}
+
+			// counting sort keeps the recorded order inside each bucket
+			u32 total = 0;
+			for (u32 i : core::range(counts.size)) {
+				u32 count = counts[i];
+				counts[i] = total;
+				total += count;
+			}
+
+			core::vector<ecs_command> sorted(total);
+			sorted.size = total;
+			for (auto& cmd : cmds.commands) {
+				if (!cmd.ops) continue;
+				u32 bucket = types.find(cmd.ops);
+				sorted[counts[bucket]++] = cmd;
+			}
+
+			u32 beg = 0;
+			for (u32 i : core::range(types.size)) {
+				u32 end = counts[i];
+				types[i]->playback(*this, &sorted[beg], end - beg, cmds.payload.data);
+				beg = end;
+			}
+
+			destroy_n(destroyed);
+
+			// payloads were moved out and dropped during playback
+			cmds.commands.size = 0;
+			cmds.payload.size = 0;
+			cmds.created = 0;
+		}
+
+		// we do not provide direct access to pool's other add overload as we can't guarantee atomicity
+		template<typename T>
+		void add(e_id e, T&& item) {
+			{
+				auto pool = core::wview_create(view<T>());
+				pool->add(e, forward_data(item));
+			}
+
+			u64 bits = bit<T>();
+			bitset[e.id()] |= bits;
+			notify(bits, &e, 1, ecs_event::add);
+		}
+
+		template<typename T>
+		void add(e_id e, cref<T> item) {
+			add(e, forward_data(core::copy(item)));
+		}
+
+		// callbacks run before the component is removed so owning groups can unpack it first
+		template<typename T>
+		void del(e_id e) {
+			u64 bits = bit<T>();
+			bitset[e.id()] &= ~bits;
+			notify(bits, &e, 1, ecs_event::del);
+
+			auto pool = core::wview_create(view<T>());
+			pool->del(e);
 		}
 
 		// get functions do require additional synchronization
@@ -435,44 +1586,231 @@ export namespace jolly {
 			return busy;
 		}
 
+		// enable change tracking for T, existing components are stamped as added now
+		template<typename T>
+		void track() {
+			auto pool = core::wview_create(view<T>());
+			pool->track(&tick);
+		}
+
+		// writes a tick, so it is only reachable through a wview of the ecs
+		template<typename T>
+		ref<T> patch(e_id e) {
+			auto pool = core::wview_create(view<T>());
+			return pool->patch(e);
+		}
+
+		// components matching Filter (added<T> or changed<T>) stamped after since
+		// consumers keep the value returned by advance() and pass it back on their next run
+		template<typename Filter>
+		tick_view<Filter> filter(u32 since) const {
+			return tick_view<Filter>(view<typename Filter::type>(), since);
+		}
+
+		template<typename T, typename Cmp>
+		void sort(Cmp cmp) {
+			auto pool = core::wview_create(view<T>());
+			pool->sort(cmp);
+		}
+
+		// T follows U's dense order so iterating both by entity walks memory linearly
+		template<typename T, typename U>
+		void sort_as() {
+			static_assert(!core::is_same_v<T, U>, "a pool cannot follow itself, both views would lock it");
+			auto& follower = view<T>();
+			auto& leader = view<U>();
+			auto a = core::wview_create(follower);
+			auto b = core::rview_create(leader);
+			follower.sort_as(leader);
+		}
+
+		// keeps T sorted as U over time, call compact once per tick
+		template<typename T, typename U>
+		void compact_as() {
+			static_assert(!core::is_same_v<T, U>, "a pool cannot follow itself, both views would lock it");
+			auto step = [](ref<ecs> state, ref<pool_compaction> job, u32 budget) {
+				auto& follower = state.view<T>();
+				auto& leader = state.view<U>();
+				auto a = core::wview_create(follower);
+				auto b = core::rview_create(leader);
+				if (follower.owner != U64_MAX) return (u32)0;
+
+				if (job.versions[0] != follower.version || job.versions[1] != leader.version) {
+					job.cursor = 0;
+					job.pos = 0;
+					job.versions[0] = follower.version;
+					job.versions[1] = leader.version;
+				}
+
+				u32 swaps = 0;
+				for (u32 i : core::range(budget)) {
+					if (job.cursor >= leader.set.dense.size) {
+						job.cursor = 0;
+						job.pos = 0;
+						break;
+					}
+
+					e_id e = leader.set.dense[job.cursor++];
+					if (!follower.has(e)) continue;
+
+					u32 idx = follower.set.index(e);
+					if (idx != job.pos) {
+						follower.swap(idx, job.pos);
+						swaps++;
+					}
+
+					job.pos++;
+				}
+
+				return swaps;
+			};
+
+			compactions.add(pool_compaction{ step, 0, 0, { U32_MAX, U32_MAX } });
+		}
+
+		// returns the number of swaps made, budget is split between the registered policies
+		u32 compact(u32 budget = COMPACT_BUDGET) {
+			if (!compactions.size) return 0;
+
+			u32 swaps = 0;
+			u32 share = core::max(budget / compactions.size, (u32)1);
+			for (auto& job : compactions) {
+				swaps += job.step(*this, job, share);
+			}
+
+			return swaps;
+		}
+
+		// every stamp made so far is <= the returned tick
+		u32 advance() {
+			return tick++;
+		}
+
 		template<typename T>
 		bool has(e_id e) const {
 			auto pool = core::rview_create(view<T>());
 			return pool->has(e);
 		}
 
+		// slots are per ecs, U32_MAX until T is registered here
+		template<typename T>
+		u32 slot() const {
+			u32 id = impl_ecs::type_id<T>();
+			return id < slots.size ? slots[id] : U32_MAX;
+		}
+
+		template<typename T>
+		void _bind(u32 idx) {
+			u32 id = impl_ecs::type_id<T>();
+			while (slots.size <= id) {
+				slots.add() = U32_MAX;
+			}
+
+			slots[id] = idx;
+		}
+
+		// signature bit of T's pool
+		template<typename T>
+		u64 bit() const {
+			u32 idx = slot<pool<T>>();
+			JOLLY_ASSERT(idx != U32_MAX, "pool is not registered");
+			return (u64)1 << idx;
+		}
+
+		// registers T's pool if needed, the result is also its signature bit
+		template<typename T>
+		u32 pool_index() {
+			view<T>();
+			return slot<pool<T>>();
+		}
+
 		template<typename T>
 		ref<pool<T>> view() {
-			if (pool<T>::index == U64_MAX)
+			u32 idx = slot<pool<T>>();
+			if (idx == U32_MAX) {
 				register_pool<T>();
-			return pools[(u32)pool<T>::index].get<pool<T>>();
+				idx = slot<pool<T>>();
+			}
+
+			return pools[idx].get<pool<T>>();
 		}
 
 		template<typename T>
 		cref<pool<T>> view() const {
-			return pools[(u32)pool<T>::index].get<pool<T>>();
+			u32 idx = slot<pool<T>>();
+			JOLLY_ASSERT(idx != U32_MAX, "pool is not registered");
+			return pools[idx].get<pool<T>>();
 		}
 
 		template<typename... Ts>
 		ref<jolly::group<Ts...>> group() {
-			if (jolly::group<Ts...>::index == U64_MAX)
+			u32 idx = slot<jolly::group<Ts...>>();
+			if (idx == U32_MAX) {
 				register_group<Ts...>();
-			return groups[(u32)jolly::group<Ts...>::index].one.get<jolly::group<Ts...>>();
+				idx = slot<jolly::group<Ts...>>();
+			}
+
+			return groups[idx].one.get<jolly::group<Ts...>>();
 		}
 
 		template<typename... Ts>
 		cref<jolly::group<Ts...>> group() const {
-			return groups[(u32)jolly::group<Ts...>::index].one.get<jolly::group<Ts...>>();
+			u32 idx = slot<jolly::group<Ts...>>();
+			JOLLY_ASSERT(idx != U32_MAX, "group is not registered");
+			return groups[idx].one.get<jolly::group<Ts...>>();
+		}
+
+		template<typename... Ts>
+		ref<jolly::owning_group<Ts...>> owning_group() {
+			u32 idx = slot<jolly::owning_group<Ts...>>();
+			if (idx == U32_MAX) {
+				register_owning_group<Ts...>();
+				idx = slot<jolly::owning_group<Ts...>>();
+			}
+
+			return groups[idx].one.get<jolly::owning_group<Ts...>>();
+		}
+
+		template<typename... Ts>
+		cref<jolly::owning_group<Ts...>> owning_group() const {
+			u32 idx = slot<jolly::owning_group<Ts...>>();
+			JOLLY_ASSERT(idx != U32_MAX, "group is not registered");
+			return groups[idx].one.get<jolly::owning_group<Ts...>>();
+		}
+
+		// the returned query is refreshed, iterate it through a rview/wview
+		template<typename With, typename Without = without<>>
+		ref<jolly::query<With, Without>> query() {
+			using query_type = jolly::query<With, Without>;
+			u32 idx = slot<query_type>();
+			if (idx == U32_MAX) {
+				idx = queries.size;
+				_bind<query_type>(idx);
+				queries.add(core::mem_create<query_type>(*this));
+			}
+
+			auto& q = queries[idx].get<query_type>();
+			q.refresh();
+			return q;
 		}
 
 		core::vector<e_id> entities;
 		core::vector<u64> bitset;
+		core::vector<u32> slots; // indexed by impl_ecs::type_id, shared by pools, groups and queries
 		core::vector<core::any> pools;
+		core::vector<pool_ops> ops;
+		core::vector<pool_signals> signals;
 		core::vector<core::pair<core::any, u64>> groups;
+		core::vector<core::any> queries;
+		core::vector<pool_compaction> compactions;
 		core::vector<core::vector<pfn_ecs_cb>> callbacks;
+		core::vector<ecs_commands> pending;
+		core::mutex pending_lock;
 		core::rwlock busy;
 
 		u32 free;
+		u32 tick;
+		u32 observers; // ids handed out by observe
 	};
 
 	template <typename T>
@@ -480,12 +1818,45 @@ export namespace jolly {
 		auto& view = state.view<T>();
 		return view.get_lock();
 	}
+
+	// applies a bucket of commands for T, consecutive adds or dels form one batch
+	template <typename T>
+	void ecs_playback(ref<ecs> state, cptr<ecs_command> cmds, u32 count, ptr<u8> payload) {
+		core::vector<e_id> batch(count);
+		u32 beg = 0;
+		while (beg < count) {
+			ecs_op op = cmds[beg].op;
+			u32 end = beg;
+
+			batch.size = 0;
+			while (end < count && cmds[end].op == op) {
+				batch.add(cmds[end].entity);
+				end++;
+			}
+
+			if (op == ecs_op::add) {
+				auto item = [&](u32 i) -> fwd<T> {
+					return static_cast<fwd<T>>(*(ptr<T>)&payload[cmds[beg + i].payload]);
+				};
+
+				state._add_batch<T>(batch.data, batch.size, item);
+				for (u32 i : core::range(beg, end)) {
+					ecs_drop<T>(&payload[cmds[i].payload]);
+				}
+			} else {
+				state._del_batch<T>(batch.data, batch.size);
+			}
+
+			beg = end;
+		}
+	}
 }
 
 namespace jolly {
+	// locks the group and every pool it touches once for the lifetime of the view
 	template <typename Impl, typename... Ts>
 	struct group_view_impl: public Impl {
-		using this_type = group<Ts...>;
+		using this_type = typename Impl::type;
 		static void acquire(cref<core::rwlock> l, ref<this_type> in) {
 			auto helper = [](cref<core::rwlock> l, ref<this_type> in) {
 				Impl::acquire(l, in);
@@ -517,10 +1888,42 @@ using rview_impl_t = jolly::group_view_impl<core::rview_impl<group_t<Ts...>>, Ts
 template <typename... Ts>
 using wview_impl_t = jolly::group_view_impl<core::wview_impl<group_t<Ts...>>, Ts...>;
 
+template <typename... Ts>
+using owning_group_t = jolly::owning_group<Ts...>;
+
+template <typename... Ts>
+using owning_rview_impl_t = jolly::group_view_impl<core::rview_impl<owning_group_t<Ts...>>, Ts...>;
+
+template <typename... Ts>
+using owning_wview_impl_t = jolly::group_view_impl<core::wview_impl<owning_group_t<Ts...>>, Ts...>;
+
+template <typename Q, typename... Ts>
+using query_rview_impl_t = jolly::group_view_impl<core::rview_impl<Q>, Ts...>;
+
+template <typename Q, typename... Ts>
+using query_wview_impl_t = jolly::group_view_impl<core::wview_impl<Q>, Ts...>;
+
 export namespace core {
 	template<typename... Ts>
 	struct rview<group_t<Ts...>>: public view_base<group_t<Ts...>, rview_impl_t<Ts...>> {};
 
 	template<typename... Ts>
 	struct wview<group_t<Ts...>>: public view_base<group_t<Ts...>, wview_impl_t<Ts...>> {};
+
+	template<typename... Ts>
+	struct rview<owning_group_t<Ts...>>: public view_base<owning_group_t<Ts...>, owning_rview_impl_t<Ts...>> {};
+
+	template<typename... Ts>
+	struct wview<owning_group_t<Ts...>>: public view_base<owning_group_t<Ts...>, owning_wview_impl_t<Ts...>> {};
+
+	// only the With pools are locked, Without pools are never read while iterating
+	template<typename... Ts, typename... Xs>
+	struct rview<jolly::query<jolly::with<Ts...>, jolly::without<Xs...>>>
+	: public view_base<jolly::query<jolly::with<Ts...>, jolly::without<Xs...>>,
+		query_rview_impl_t<jolly::query<jolly::with<Ts...>, jolly::without<Xs...>>, Ts...>> {};
+
+	template<typename... Ts, typename... Xs>
+	struct wview<jolly::query<jolly::with<Ts...>, jolly::without<Xs...>>>
+	: public view_base<jolly::query<jolly::with<Ts...>, jolly::without<Xs...>>,
+		query_wview_impl_t<jolly::query<jolly::with<Ts...>, jolly::without<Xs...>>, Ts...>> {};
 }
@@ -6,6 +6,10 @@ export module jolly.engine;
 import core.types;
 import jolly.system;
 import jolly.ecs;
+import jolly.extract;
+import jolly.spatial;
+import jolly.transform;
+import jolly.parallel;
 import core.table;
 import core.string;
 import core.atom;
@@ -19,6 +23,9 @@ export namespace jolly {
 		engine()
 		: _systems()
 		, _ecs()
+		, _extract()
+		, _transforms()
+		, _spatial()
 		, _busy()
 		, _run(true) {
 			JOLLY_ASSERT(_instance.data == nullptr, "cannot have more than one engine instance");
@@ -41,6 +48,7 @@ export namespace jolly {
 		// do not call with an owning view
 		void run() {
 			f32 dt = 0;
+			par_default().start(par_workers() - 1);
 
 			bool run = _run.get(core::memory_order_relaxed);
 			while (run) {
@@ -50,12 +58,29 @@ export namespace jolly {
 					sys->step(dt);
 				}
 
+				// sync point, apply structural changes deferred by systems this tick
+				{
+					auto state = core::wview_create(_ecs);
+					state->flush();
+					// world transforms land in quad_component, the index has to see them this tick
+					if (_transforms.update(*state) == transform_error::cycle) {
+						LOG_WARN("transform hierarchy contains a cycle, its nodes are not propagated");
+					}
+
+					_spatial.update(*state);
+					_extract.extract(*state);
+					state->compact();
+					state->advance();
+				}
+
 				run = _run.get(core::memory_order_relaxed);
 			}
 
 			for (auto& sys : _systems.vals()) {
 				sys->term();
 			}
+
+			par_default().stop();
 		}
 
 		void stop() {
@@ -66,6 +91,16 @@ export namespace jolly {
 			return _ecs;
 		}
 
+		// render thread only, see render_extract::latest
+		cref<render_frame> extracted() {
+			return _extract.latest();
+		}
+
+		// quads as of the last sync point, read under an ecs view
+		cref<spatial_index> spatial() const {
+			return _spatial;
+		}
+
 		cref<core::rwlock> get_lock() const {
 			return _busy;
 		}
@@ -78,6 +113,9 @@ export namespace jolly {
 
 		core::table<core::string, core::mem<system>> _systems;
 		ecs _ecs;
+		render_extract _extract;
+		transform_system _transforms;
+		spatial_index _spatial;
 		core::rwlock _busy;
 		core::atom<bool> _run;
 
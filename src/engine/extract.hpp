@@ -0,0 +1,104 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.extract;
+import core.types;
+import core.vector;
+import core.simd;
+import core.atom;
+import core.lock;
+import jolly.ecs;
+import jolly.components;
+
+export namespace jolly {
+	// single producer, single consumer, neither side ever waits
+	// the producer owns back, the consumer owns front, the third slot is handed over through state
+	// state holds the hand-off index and a fresh bit set by publish and cleared by acquire
+	template <typename T>
+	struct triple_buffer {
+		using type = T;
+
+		static constexpr u32 FRESH = 1 << 2;
+		static constexpr u32 INDEX_MASK = FRESH - 1;
+
+		triple_buffer()
+		: slots()
+		, back(0)
+		, front(1)
+		, state(2) {}
+
+		ref<type> write_slot() {
+			return slots[back];
+		}
+
+		// hands the written slot over, an unconsumed frame in the middle is recycled
+		void publish() {
+			u32 expected = state.get(core::memory_order_relaxed);
+			while (!state.cmpxchg(expected, back | FRESH, core::memory_order_release, core::memory_order_relaxed));
+			back = expected & INDEX_MASK;
+		}
+
+		// returns true if a newer frame became the front slot
+		bool acquire() {
+			u32 expected = state.get(core::memory_order_acquire);
+			if (!(expected & FRESH)) return false;
+
+			while (!state.cmpxchg(expected, front, core::memory_order_release, core::memory_order_relaxed));
+			front = expected & INDEX_MASK;
+			return true;
+		}
+
+		cref<type> read_slot() const {
+			return slots[front];
+		}
+
+		type slots[3];
+		u32 back;
+		u32 front;
+		core::atom<u32> state;
+	};
+
+	// everything the renderer needs from the ecs for one tick
+	struct render_frame {
+		render_frame()
+		: quads(0)
+		, tick(0) {}
+
+		core::vector<quad_component> quads;
+		u32 tick;
+	};
+
+	// copies render components out of the ecs at the end of a tick, the render thread
+	// reads the latest complete frame without taking any ecs locks
+	struct render_extract {
+		render_extract()
+		: frames() {}
+
+		// called by the engine with the ecs locked, only one thread may extract
+		void extract(ref<ecs> state) {
+			auto& frame = frames.write_slot();
+			{
+				auto pool = core::rview_create(state.view<quad_component>());
+				u32 count = pool->components.size;
+				if (frame.quads.reserve < count) {
+					frame.quads.resize(count);
+				}
+
+				core::copy8((ptr<u8>)pool->components.data, (ptr<u8>)frame.quads.data, count * (u32)sizeof(quad_component));
+				frame.quads.size = count;
+			}
+
+			frame.tick = state.tick;
+			frames.publish();
+		}
+
+		// render thread only, the returned frame stays valid until the next call
+		cref<render_frame> latest() {
+			frames.acquire();
+			return frames.read_slot();
+		}
+
+		triple_buffer<render_frame> frames;
+	};
+}
@@ -0,0 +1,264 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.parallel;
+import core.types;
+import core.vector;
+import core.memory;
+import core.simd;
+import core.atom;
+import core.lock;
+import core.thread;
+import core.iterator;
+import jolly.ecs;
+
+export namespace jolly {
+	constexpr u32 PAR_MAX_WORKERS = core::BLOCK_64;
+	constexpr u32 PAR_MIN_CHUNK = core::BLOCK_256;
+	constexpr u32 PAR_CHUNKS_PER_WORKER = 4; // a few chunks per worker to even out the tail
+
+	typedef void (*pfn_par_chunk)(ptr<void> ctx, u32 chunk, u32 beg, u32 end);
+
+	// workers claim chunks from a shared counter until none are left
+	struct par_job {
+		par_job(pfn_par_chunk in, ptr<void> data, u32 total, u32 size)
+		: fn(in)
+		, ctx(data)
+		, count(total)
+		, chunk(size)
+		, chunks((total + size - 1) / size)
+		, next(0) {}
+
+		void work() {
+			u32 idx = next.get(core::memory_order_relaxed);
+			while (idx < chunks) {
+				// on failure idx is reloaded
+				if (!next.cmpxchg(idx, idx + 1, core::memory_order_release, core::memory_order_relaxed)) continue;
+
+				u32 beg = idx * chunk;
+				fn(ctx, idx, beg, core::min(beg + chunk, count));
+				idx = next.get(core::memory_order_relaxed);
+			}
+		}
+
+		pfn_par_chunk fn;
+		ptr<void> ctx;
+		u32 count;
+		u32 chunk;
+		u32 chunks;
+		core::atom<u32> next;
+	};
+
+	u32 par_workers() {
+		return core::min(core::hardware_threads(), PAR_MAX_WORKERS);
+	}
+
+	u32 par_line(u32 size) {
+		u32 a = size;
+		u32 b = core::BLOCK_64;
+		while (b) {
+			u32 tmp = a % b;
+			a = b;
+			b = tmp;
+		}
+
+		return core::BLOCK_64 / a;
+	}
+
+	// elements per cache line of the columns a container walks linearly,
+	// groups and queries go through sparse lookups so any boundary will do
+	template <typename C>
+	struct par_stride {
+		static u32 line() { return 1; }
+	};
+
+	template <typename T>
+	struct par_stride<pool<T>> {
+		static u32 line() { return par_line(sizeof(T)); }
+	};
+
+	template <typename... Ts>
+	struct par_stride<owning_group<Ts...>> {
+		static u32 line() {
+			u32 line = 1;
+			((line = core::max(line, par_line(sizeof(Ts)))), ...);
+			return line;
+		}
+	};
+
+	// chunks cover whole cache lines so neighbouring workers never write to the same line
+	u32 par_chunk_size(u32 count, u32 line, u32 workers) {
+		u32 target = core::max(count / (workers * PAR_CHUNKS_PER_WORKER), (u32)PAR_MIN_CHUNK);
+		return (target + line - 1) / line * line;
+	}
+
+	// workers are started once and parked on a semaphore between calls, a call hands them its
+	// job and waits until every worker it woke has let go of it
+	// the calling thread works too, so one thread less than par_workers is started
+	struct par_pool {
+		par_pool()
+		: threads()
+		, wake(PAR_MAX_WORKERS, 0)
+		, done(PAR_MAX_WORKERS, 0)
+		, job(nullptr)
+		, count(0)
+		, busy(false)
+		, run(true) {}
+
+		~par_pool() {
+			stop();
+		}
+
+		void start(u32 workers) {
+			if (count) return;
+
+			auto loop = [](ref<core::thread> _, core::mem<void>&& args) {
+				auto owner = args.cast<par_pool>();
+				ptr<par_pool> pool = &owner.get();
+				owner = nullptr; // the pool outlives its workers
+
+				for (;;) {
+					pool->wake.acquire();
+					if (!pool->run.get(core::memory_order_relaxed)) return 0;
+					pool->job->work();
+					pool->done.release();
+				}
+			};
+
+			run.set(true, core::memory_order_relaxed);
+			count = core::min(workers, PAR_MAX_WORKERS - 1);
+			for (u32 i : core::range(count)) {
+				threads[i] = core::thread((core::pfn_thread)loop, core::mem<void>((ptr<void>)this));
+			}
+		}
+
+		// only call while no par_for is running
+		void stop() {
+			if (!count) return;
+
+			run.set(false, core::memory_order_relaxed);
+			for (u32 i : core::range(count)) {
+				wake.release();
+			}
+
+			for (u32 i : core::range(count)) {
+				threads[i].join();
+			}
+
+			count = 0;
+		}
+
+		// every wake is answered by exactly one done, whichever worker picks it up
+		// nested and concurrent calls find the pool busy and run on the calling thread alone
+		void dispatch(ref<par_job> in) {
+			bool idle = false;
+			if (in.chunks < 2 || !busy.cmpxchg(idle, true, core::memory_order_release, core::memory_order_relaxed)) {
+				in.work();
+				return;
+			}
+
+			if (!count) start(par_workers() - 1);
+
+			job = &in;
+			u32 helpers = core::min(count, in.chunks - 1);
+			for (u32 i : core::range(helpers)) {
+				wake.release();
+			}
+
+			in.work();
+
+			for (u32 i : core::range(helpers)) {
+				done.acquire();
+			}
+
+			job = nullptr;
+			busy.set(false, core::memory_order_release);
+		}
+
+		core::thread threads[PAR_MAX_WORKERS];
+		core::semaphore wake;
+		core::semaphore done;
+		ptr<par_job> job;
+		u32 count;
+		core::atom<bool> busy;
+		core::atom<bool> run;
+	};
+
+	// shared by every par_for, the engine starts it with the engine loop and stops it after
+	// the systems terminate, callers outside the engine start it on first use
+	ref<par_pool> par_default() {
+		static par_pool pool;
+		return pool;
+	}
+
+	void par_for(u32 count, u32 chunk, pfn_par_chunk fn, ptr<void> ctx) {
+		par_job job(fn, ctx, count, chunk);
+		par_default().dispatch(job);
+	}
+
+	template <typename Body>
+	void _par_run(u32 count, u32 chunk, ref<Body> body) {
+		auto invoke = [](ptr<void> ctx, u32 chunk, u32 beg, u32 end) {
+			(*(ptr<Body>)ctx)(chunk, beg, end);
+		};
+
+		par_for(count, chunk, invoke, (ptr<void>)&body);
+	}
+
+	// C is a pool, group, owning_group or query, fn(e_id, item) receives the same item as the
+	// sequential iterator, the container and its pools are write locked once for the whole call
+	// fn runs concurrently and must only touch the entity it was given
+	template <typename C, typename Fn>
+	void par_each(ref<C> container, Fn fn) {
+		auto view = core::wview_create(container);
+		u32 count = container.end().index;
+		if (!count) return;
+
+		auto body = [&](u32 chunk, u32 beg, u32 end) {
+			for (u32 i : core::range(beg, end)) {
+				typename C::iterator it(container, i);
+				auto [e, item] = *it;
+				fn(e, item);
+			}
+		};
+
+		_par_run(count, par_chunk_size(count, par_stride<C>::line(), par_workers()), body);
+	}
+
+	// every chunk folds into its own accumulator, accumulators are combined in chunk order
+	// chunk boundaries only depend on count, so results are reproducible across runs and machines
+	// even for non associative operations like float addition
+	template <typename C, typename R, typename Fn, typename Combine>
+	R par_reduce(ref<C> container, R init, Fn fn, Combine combine) {
+		auto view = core::rview_create(container);
+		u32 count = container.end().index;
+		if (!count) return init;
+
+		u32 chunk = par_chunk_size(count, par_stride<C>::line(), PAR_MAX_WORKERS);
+		u32 chunks = (count + chunk - 1) / chunk;
+
+		core::vector<R> partial(chunks);
+		for (u32 i : core::range(chunks)) {
+			partial.add(init);
+		}
+
+		auto body = [&](u32 idx, u32 beg, u32 end) {
+			auto& acc = partial[idx];
+			for (u32 i : core::range(beg, end)) {
+				typename C::iterator it(container, i);
+				auto [e, item] = *it;
+				fn(acc, e, item);
+			}
+		};
+
+		_par_run(count, chunk, body);
+
+		R result = init;
+		for (auto& acc : partial) {
+			combine(result, acc);
+		}
+
+		return result;
+	}
+}
@@ -0,0 +1,266 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.prefab;
+import core.types;
+import core.vector;
+import core.memory;
+import core.lock;
+import core.operations;
+import core.traits;
+import core.iterator;
+import math.vec;
+import jolly.ecs;
+import jolly.jml;
+import jolly.components;
+
+export namespace jolly {
+	typedef u32 (*pfn_prefab_index)(ref<ecs> state);
+	typedef void (*pfn_prefab_spawn)(ref<ecs> state, cptr<u8> item, core::span<e_id> e);
+	typedef void (*pfn_prefab_drop)(ptr<u8> item);
+
+	struct prefab_ops {
+		pfn_prefab_index index;
+		pfn_prefab_spawn spawn;
+		pfn_prefab_drop drop;
+	};
+
+	template <typename T>
+	inline prefab_ops prefab_ops_v = {
+		[](ref<ecs> state) {
+			return state.pool_index<T>();
+		},
+		// one lock and one reserve per pool for the whole batch
+		[](ref<ecs> state, cptr<u8> item, core::span<e_id> e) {
+			auto pool = core::wview_create(state.view<T>());
+			pool->fill_n(e, *(cptr<T>)item);
+		},
+		[](ptr<u8> item) {
+			core::destroy((ptr<T>)item);
+		},
+	};
+
+	struct prefab_entry {
+		u32 offset; // into the prefab's block
+		cptr<prefab_ops> ops;
+	};
+
+	// one instance of every component laid out back to back, instantiate copies the block
+	// into each pool in bulk instead of going through ecs::add per entity and component
+	struct prefab {
+		prefab()
+		: entries(0)
+		, block(0) {}
+
+		prefab(fwd<prefab> other)
+		: entries()
+		, block() {
+			*this = forward_data(other);
+		}
+
+		~prefab() {
+			clear();
+		}
+
+		// vector move assignment does not free, the old components and storage go first
+		ref<prefab> operator=(fwd<prefab> other) {
+			clear();
+			if (entries.data) entries.destroy();
+			if (block.data) block.destroy();
+
+			entries = forward_data(other.entries);
+			block = forward_data(other.block);
+			return *this;
+		}
+
+		// lvalues deduce T as a reference, the stored component is always the plain type
+		template<typename T>
+		ref<prefab> add(T&& item) {
+			using type = core::raw_type_t<T>;
+			JOLLY_ASSERT(!has<type>(), "prefab already contains this component");
+			u32 offset = _allocate(sizeof(type), alignof(type));
+			new (&block[offset]) type(forward_data(item));
+			entries.add(prefab_entry{ offset, &prefab_ops_v<type> });
+			return *this;
+		}
+
+		template<typename T>
+		ref<prefab> add(cref<T> item) {
+			return add(forward_data(core::copy(item)));
+		}
+
+		template<typename T>
+		bool has() const {
+			for (auto& entry : entries) {
+				if (entry.ops == &prefab_ops_v<T>) return true;
+			}
+
+			return false;
+		}
+
+		// nullptr if the prefab does not contain T
+		template<typename T>
+		ptr<T> get() {
+			for (auto& entry : entries) {
+				if (entry.ops == &prefab_ops_v<T>) return (ptr<T>)&block[entry.offset];
+			}
+
+			return nullptr;
+		}
+
+		void clear() {
+			if (!entries.data) return;
+			for (auto& entry : entries) {
+				entry.ops->drop(&block[entry.offset]);
+			}
+
+			entries.size = 0;
+			block.size = 0;
+		}
+
+		// the caller holds a wview of the ecs, every entity in out is created and receives
+		// a copy of each component, observers and groups are notified once for the batch
+		void instantiate(ref<ecs> state, core::span<e_id> out) const {
+			state.create_n(out);
+
+			u64 bits = 0;
+			for (auto& entry : entries) {
+				bits |= (u64)1 << entry.ops->index(state);
+				entry.ops->spawn(state, &block[entry.offset], out);
+			}
+
+			for (e_id entity : out) {
+				state.bitset[entity.id()] = bits;
+			}
+
+			state.notify(bits, out.data, out.size, ecs_event::add);
+		}
+
+		core::vector<e_id> instantiate(ref<ecs> state, u32 count) const {
+			core::vector<e_id> out(count);
+			out.size = count;
+			instantiate(state, out);
+			return out;
+		}
+
+		u32 _allocate(u32 bytes, u32 align) {
+			u32 offset = (block.size + align - 1) & ~(align - 1);
+			if (block.reserve < offset + bytes) {
+				block.resize(core::max<u32>(block.reserve * 2, offset + bytes));
+			}
+
+			block.size = offset + bytes;
+			return offset;
+		}
+
+		core::vector<prefab_entry> entries;
+		core::vector<u8> block;
+	};
+
+	// looks up a direct child of node, nullptr if it is missing
+	cptr<jml_val> prefab_field(cref<jml_doc> doc, cref<jml_tbl> node, core::stringview name) {
+		jml_tbl key{ name, &node, nullptr };
+		return doc.data.find(key);
+	}
+
+	f32 prefab_f32(cref<jml_doc> doc, cref<jml_tbl> node, core::stringview name, f32 fallback) {
+		cptr<jml_val> val = prefab_field(doc, node, name);
+		if (!val || val->type != jml_type::num) return fallback;
+		return (f32)val->raw<f64>();
+	}
+
+	math::vec2f prefab_vec2f(cref<jml_doc> doc, cref<jml_tbl> node, core::stringview name, math::vec2f fallback) {
+		cptr<jml_val> val = prefab_field(doc, node, name);
+		if (!val || val->type != jml_type::arr || val->size() < 2) return fallback;
+		auto& vec = val->raw<core::vector<jml_val>>();
+		return math::vec2f{ (f32)vec[0].get<f64>(), (f32)vec[1].get<f64>() };
+	}
+
+	math::vec3f prefab_vec3f(cref<jml_doc> doc, cref<jml_tbl> node, core::stringview name, math::vec3f fallback) {
+		cptr<jml_val> val = prefab_field(doc, node, name);
+		if (!val || val->type != jml_type::arr || val->size() < 3) return fallback;
+		auto& vec = val->raw<core::vector<jml_val>>();
+		return math::vec3f{ (f32)vec[0].get<f64>(), (f32)vec[1].get<f64>(), (f32)vec[2].get<f64>() };
+	}
+
+	// builds a component from its jml table, specialize for every type a jml prefab may use
+	template <typename T>
+	struct prefab_reader;
+
+	template <>
+	struct prefab_reader<quad_component> {
+		static quad_component read(cref<jml_doc> doc, cref<jml_tbl> node) {
+			quad_component quad;
+			quad.pos = prefab_vec2f(doc, node, "pos", math::vec2f{ 0, 0 });
+			quad.scale = prefab_vec2f(doc, node, "scale", math::vec2f{ 1, 1 });
+			quad.color = prefab_vec3f(doc, node, "color", math::vec3f{ 1, 1, 1 });
+			return quad;
+		}
+	};
+
+	template <>
+	struct prefab_reader<transform_component> {
+		static transform_component read(cref<jml_doc> doc, cref<jml_tbl> node) {
+			transform_component transform;
+			transform.pos = prefab_vec2f(doc, node, "pos", math::vec2f{ 0, 0 });
+			transform.scale = prefab_vec2f(doc, node, "scale", math::vec2f{ 1, 1 });
+			transform.rotation = prefab_f32(doc, node, "rotation", 0);
+			return transform;
+		}
+	};
+
+	typedef void (*pfn_prefab_load)(ref<prefab> out, cref<jml_doc> doc, cref<jml_tbl> node);
+
+	struct prefab_type {
+		core::stringview name;
+		pfn_prefab_load load;
+	};
+
+	// maps jml table names to components, e.g.
+	//
+	// enemy = {
+	//     quad = { pos = [ 0, 0 ], scale = [ 16, 16 ], color = [ 1, 0, 0 ] },
+	//     transform = { rotation = 0.5 }
+	// }
+	struct prefab_registry {
+		prefab_registry()
+		: types(0) {}
+
+		template<typename T>
+		void add(core::stringview name) {
+			auto load = [](ref<prefab> out, cref<jml_doc> doc, cref<jml_tbl> node) {
+				out.add(prefab_reader<T>::read(doc, node));
+			};
+
+			JOLLY_ASSERT(!find(name), "prefab type registered twice");
+			types.add(prefab_type{ name, load });
+		}
+
+		cptr<prefab_type> find(core::stringview name) const {
+			for (auto& type : types) {
+				if (type.name == name) return &type;
+			}
+
+			return nullptr;
+		}
+
+		// children of node that are not registered are ignored
+		prefab load(cref<jml_doc> doc, cref<jml_tbl> node) const {
+			prefab res;
+			for (auto& type : types) {
+				cptr<jml_val> val = prefab_field(doc, node, type.name);
+				if (!val || val->type != jml_type::tbl) continue;
+				type.load(res, doc, val->raw<jml_tbl>());
+			}
+
+			return res;
+		}
+
+		prefab load(cref<jml_doc> doc, core::stringview name) const {
+			return load(doc, doc.get(name).raw<jml_tbl>());
+		}
+
+		core::vector<prefab_type> types;
+	};
+}
@@ -0,0 +1,177 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.reload;
+import core.types;
+import core.vector;
+import core.string;
+import core.memory;
+import core.lock;
+import core.atom;
+import core.file;
+import core.simd;
+import core.log;
+import jolly.system;
+import jolly.jml;
+
+export namespace jolly {
+	typedef void (*pfn_jml_reload)(ptr<void> user, cref<jml_tape> doc, cref<jml_change> change);
+
+	struct jml_subscriber {
+		u32 file;
+		u64 hash; // path to watch, a table also fires when anything below it changes
+		pfn_jml_reload callback;
+		ptr<void> user;
+	};
+
+	// live is only read and swapped on the engine thread, pending and changes belong to the
+	// watcher until ready is set and to the engine thread until it is cleared
+	struct jml_watched {
+		jml_watched(core::stringview fname)
+		: path(fname)
+		, modified(0)
+		, failed(0)
+		, live()
+		, pending()
+		, changes(0)
+		, ready(false) {}
+
+		core::string path;
+		u64 modified; // stamp of the live tape
+		u64 failed; // stamp of the last parse that failed, 0 if none
+		jml_tape live;
+		jml_tape pending;
+		core::vector<jml_change> changes;
+		bool ready;
+	};
+
+	// watches jml files and reparses them in the background when they are written, the diff
+	// against the live tape is computed there too, so the engine thread only swaps tapes and
+	// calls the subscribers of the paths that changed
+	// the watcher sleeps on os change notification for the files' directories, a wake up
+	// compares the last write time of every file to find the ones that changed
+	struct jml_reload : public system_thread {
+		static constexpr u32 INTERVAL = 100; // ms between checks of the run flag and deferred reloads
+
+		jml_reload()
+		: system_thread()
+		, _files(0)
+		, _subscribers(0)
+		, _watch()
+		, _lock()
+		, _run(true) {}
+
+		// call before the system is added, returns the index used to subscribe
+		u32 watch(core::stringview path) {
+			auto file = core::mem_create<jml_watched>(path);
+			jml_result res = jml_load(file->live, path);
+			if (res.error != jml_error::none) {
+				// a partial tape would be diffed against the next good parse, start empty instead
+				LOG_WARN("failed to load % at line %", file->path, res.line);
+				file->live.clear();
+			}
+
+			file->modified = core::fmodified(path);
+			_watch.add(path);
+			_files.add(forward_data(file));
+			return _files.size - 1;
+		}
+
+		// engine thread only, the tape is valid until the next step
+		cref<jml_tape> get(u32 file) const {
+			return _files[file]->live;
+		}
+
+		// path is a dotted key path like "mydict.inner.myval"
+		void subscribe(u32 file, core::stringview path, pfn_jml_reload callback, ptr<void> user) {
+			u64 hash = JML_HASH_SEED;
+			u32 beg = 0;
+			for (u32 i = 0; i <= path.size; i++) {
+				if (i < path.size && path.data[i] != '.') continue;
+				hash = jml_hash_child(hash, core::stringview(path.data + beg, i - beg));
+				beg = i + 1;
+			}
+
+			_subscribers.add(jml_subscriber{ file, hash, callback, user });
+		}
+
+		virtual void term() {
+			_run.set(false, core::memory_order_relaxed);
+			system_thread::term();
+		}
+
+		virtual void run() {
+			bool run = _run.get(core::memory_order_relaxed);
+			while (run) {
+				bool written = _watch.wait(INTERVAL);
+				for (auto& file : _files) {
+					_poll(*file, written);
+				}
+
+				run = _run.get(core::memory_order_relaxed);
+			}
+		}
+
+		// the stamp is only taken once the file parsed, a file caught halfway through a write
+		// is tried again on the next write even if its stamp did not move
+		void _poll(ref<jml_watched> file, bool written) {
+			u64 stamp = core::fmodified(file.path);
+			if (stamp == file.modified) return;
+			if (stamp == file.failed && !written) return;
+
+			// the last reload has not been delivered yet, try again on the next poll
+			{
+				core::lock guard(_lock);
+				if (file.ready) return;
+			}
+
+			jml_result res = jml_load(file.pending, file.path);
+			if (res.error != jml_error::none) {
+				LOG_WARN("failed to reload % at line %", file.path, res.line);
+				file.failed = stamp;
+				return;
+			}
+
+			file.modified = stamp;
+			file.failed = 0;
+
+			core::lock guard(_lock);
+			file.changes.size = 0;
+			jml_diff(file.live, file.pending, file.changes);
+			file.ready = file.changes.size != 0;
+		}
+
+		// never waits on the watcher, a reload that is being published is picked up next step
+		virtual void step(f32 ms) {
+			if (!_lock.tryacquire()) return;
+			for (u32 i = 0; i < _files.size; i++) {
+				auto& file = *_files[i];
+				if (!file.ready) continue;
+
+				// tapes only hold pointers into their own allocations, a byte swap moves them
+				core::swap8((ptr<u8>)&file.live, (ptr<u8>)&file.pending, sizeof(jml_tape));
+				for (auto& change : file.changes) {
+					_dispatch(i, file.live, change);
+				}
+
+				file.ready = false;
+			}
+
+			_lock.release();
+		}
+
+		void _dispatch(u32 file, cref<jml_tape> doc, cref<jml_change> change) {
+			for (auto& sub : _subscribers) {
+				if (sub.file != file || sub.hash != change.hash) continue;
+				sub.callback(sub.user, doc, change);
+			}
+		}
+
+		core::vector<core::mem<jml_watched>> _files;
+		core::vector<jml_subscriber> _subscribers;
+		core::fwatch _watch;
+		core::mutex _lock;
+		core::atom<bool> _run;
+	};
+}
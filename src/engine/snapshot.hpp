@@ -0,0 +1,383 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.snapshot;
+import core.types;
+import core.vector;
+import core.memory;
+import core.simd;
+import core.string;
+import core.file;
+import core.lock;
+import core.traits;
+import core.operations;
+import core.iterator;
+import jolly.ecs;
+
+// snapshot layout, every block starts on a 32 byte boundary so a bulk read (or a mapped view)
+// can be used in place
+//
+// snapshot_header
+// snapshot_column[header.types]         name, version and size of every saved type
+// e_id[header.entities]                 entity slots, including the free list
+// u64[header.entities]                  signatures, bit i refers to the i-th saved type
+// per type: u32 count, e_id[count], T[count]
+
+export namespace jolly {
+	constexpr u32 SNAPSHOT_MAGIC = 0x504e534a; // JSNP
+	constexpr u32 SNAPSHOT_VERSION = 1;
+
+	enum class snapshot_error {
+		none = 0,
+		bad_magic,
+		bad_version,
+		truncated,
+		unknown_type,
+		type_mismatch,
+		too_many_types,
+		bad_entity, // a column repeats an entity or disagrees with the signatures
+	};
+
+	u32 snapshot_align(u32 offset) {
+		return (offset + core::BLOCK_32 - 1) & ~(u32)(core::BLOCK_32 - 1);
+	}
+
+	struct snapshot_header {
+		u32 magic;
+		u32 version;
+		u32 entities;
+		u32 free;
+		u32 tick;
+		u32 types;
+	};
+
+	struct snapshot_column {
+		u32 name;
+		u32 version;
+		u32 size;
+		u32 pad;
+	};
+
+	// large blocks bypass the file's staging buffer and go out as a single write
+	struct snapshot_writer {
+		snapshot_writer(ref<core::file> in)
+		: f(in)
+		, offset(0) {}
+
+		void write(core::membuf buf) {
+			if (buf.size >= core::buffer::size) {
+				f.write();
+				f.core::file_base::write(buf);
+			} else {
+				f.write(buf);
+			}
+
+			offset += buf.size;
+		}
+
+		template<typename T>
+		void write(cref<T> item) {
+			write(core::membuf{ (ptr<u8>)&item, sizeof(T) });
+		}
+
+		void align() {
+			u32 pad = snapshot_align(offset) - offset;
+			for (u32 i : core::range(pad)) {
+				f.write((u8)0);
+			}
+
+			offset += pad;
+		}
+
+		ref<core::file> f;
+		u32 offset;
+	};
+
+	struct snapshot_reader {
+		snapshot_reader(cref<core::vector<u8>> in)
+		: data(in.data)
+		, size(in.size)
+		, offset(0) {}
+
+		// returns nullptr once the snapshot runs out, sizes come from the file so they are
+		// computed in u64 by the caller and never wrap
+		cptr<u8> read(u64 bytes) {
+			if ((u64)(size - offset) < bytes) return nullptr;
+			cptr<u8> result = data + offset;
+			offset += (u32)bytes;
+			return result;
+		}
+
+		template<typename T>
+		bool read(ref<T> item) {
+			cptr<u8> src = read(sizeof(T));
+			if (!src) return false;
+			core::copy8((ptr<u8>)src, (ptr<u8>)&item, sizeof(T));
+			return true;
+		}
+
+		void align() {
+			offset = core::min(snapshot_align(offset), size);
+		}
+
+		cptr<u8> data;
+		u32 size;
+		u32 offset;
+	};
+
+	// trivially copyable components are written as one block per column,
+	// other components must specialize this, load constructs count items in place
+	// check walks the same bytes as load without constructing anything
+	template <typename T>
+	struct snapshot_serializer {
+		static_assert(core::is_trivially_copyable_v<T>, "specialize snapshot_serializer for this component");
+
+		static void save(ref<snapshot_writer> out, cptr<T> items, u32 count) {
+			out.write(core::membuf{ (ptr<u8>)items, count * (u32)sizeof(T) });
+		}
+
+		static bool load(ref<snapshot_reader> in, ptr<T> items, u32 count) {
+			cptr<u8> src = in.read((u64)count * sizeof(T));
+			if (!src) return false;
+			core::copy8((ptr<u8>)src, (ptr<u8>)items, count * (u32)sizeof(T));
+			return true;
+		}
+
+		static bool check(ref<snapshot_reader> in, u32 count) {
+			return in.read((u64)count * sizeof(T)) != nullptr;
+		}
+	};
+
+	typedef void (*pfn_snapshot_save)(ref<ecs> state, ref<snapshot_writer> out);
+	typedef bool (*pfn_snapshot_load)(ref<ecs> state, ref<snapshot_reader> in);
+	typedef snapshot_error (*pfn_snapshot_check)(ref<snapshot_reader> in, ptr<u64> found, u32 entities, u32 bit); // marks bit for every entity in the column
+	typedef u64 (*pfn_snapshot_index)(ref<ecs> state); // registers the pool if needed
+
+	struct snapshot_type {
+		u32 name; // fnv1a of the registered name, pool indices are not stable between runs
+		u32 version;
+		u32 size;
+		pfn_snapshot_index index;
+		pfn_snapshot_save save;
+		pfn_snapshot_load load;
+		pfn_snapshot_check check;
+	};
+
+	// only registered components are saved, bump version whenever the layout of T changes
+	struct snapshot_registry {
+		snapshot_registry()
+		: types(0) {}
+
+		template<typename T>
+		void add(core::stringview name, u32 version) {
+			auto save = [](ref<ecs> state, ref<snapshot_writer> out) {
+				auto pool = core::rview_create(state.view<T>());
+				u32 count = pool->set.dense.size;
+				out.write(count);
+				out.align();
+				out.write(core::membuf{ (ptr<u8>)pool->set.dense.data, count * (u32)sizeof(e_id) });
+				out.align();
+				snapshot_serializer<T>::save(out, pool->components.data, count);
+				out.align();
+			};
+
+			auto load = [](ref<ecs> state, ref<snapshot_reader> in) {
+				auto pool = core::wview_create(state.view<T>());
+				u32 count = 0;
+				if (!in.read(count)) return false;
+
+				in.align();
+				cptr<e_id> dense = (cptr<e_id>)in.read((u64)count * sizeof(e_id));
+				if (!dense) return false;
+
+				pool->reserve(count);
+				for (u32 i : core::range(count)) {
+					pool->set.add(dense[i]);
+				}
+
+				in.align();
+				ptr<T> items = &pool->components[pool->components.size];
+				if (!snapshot_serializer<T>::load(in, items, count)) return false;
+				pool->components.size += count;
+				pool->_stamp(count);
+				pool->version++;
+
+				in.align();
+				return true;
+			};
+
+			auto check = [](ref<snapshot_reader> in, ptr<u64> found, u32 entities, u32 bit) {
+				u32 count = 0;
+				if (!in.read(count)) return snapshot_error::truncated;
+
+				in.align();
+				cptr<e_id> dense = (cptr<e_id>)in.read((u64)count * sizeof(e_id));
+				if (!dense) return snapshot_error::truncated;
+
+				for (u32 i : core::range(count)) {
+					u32 id = dense[i].id();
+					if (id >= entities || (found[id] >> bit) & 1) return snapshot_error::bad_entity;
+					found[id] |= (u64)1 << bit;
+				}
+
+				in.align();
+				if (!snapshot_serializer<T>::check(in, count)) return snapshot_error::truncated;
+
+				in.align();
+				return snapshot_error::none;
+			};
+
+			auto index = [](ref<ecs> state) {
+				return (u64)state.pool_index<T>();
+			};
+
+			u32 hash = core::fnv1a((cptr<u8>)name.data, name.size);
+			JOLLY_ASSERT(!find(hash), "snapshot type registered twice");
+			JOLLY_ASSERT(types.size < ecs::MAX_POOLS, "snapshot registry is full");
+			types.add(snapshot_type{ hash, version, (u32)sizeof(T), index, save, load, check });
+		}
+
+		cptr<snapshot_type> find(u32 name) const {
+			for (auto& type : types) {
+				if (type.name == name) return &type;
+			}
+
+			return nullptr;
+		}
+
+		core::vector<snapshot_type> types;
+	};
+
+	// the caller holds a wview of the ecs, components outside the registry are skipped
+	void snapshot_save(ref<ecs> state, cref<snapshot_registry> registry, ref<core::file> f) {
+		snapshot_writer out(f);
+
+		u32 count = state.entities.size;
+		out.write(snapshot_header{ SNAPSHOT_MAGIC, SNAPSHOT_VERSION, count, state.free, state.tick, registry.types.size });
+		out.align();
+
+		u64 indices[ecs::MAX_POOLS];
+		for (u32 i : core::range(registry.types.size)) {
+			auto& type = registry.types[i];
+			indices[i] = type.index(state);
+			out.write(snapshot_column{ type.name, type.version, type.size, 0 });
+		}
+		out.align();
+
+		out.write(core::membuf{ (ptr<u8>)state.entities.data, count * (u32)sizeof(e_id) });
+		out.align();
+
+		// signatures are rewritten in registry order
+		core::vector<u64> signatures(count);
+		for (u32 i : core::range(count)) {
+			u64 bits = state.bitset[i];
+			u64 remapped = 0;
+			for (u32 j : core::range(registry.types.size)) {
+				remapped |= ((bits >> indices[j]) & 1) << j;
+			}
+
+			signatures.add(remapped);
+		}
+
+		out.write(core::membuf{ (ptr<u8>)signatures.data, count * (u32)sizeof(u64) });
+		out.align();
+
+		for (auto& type : registry.types) {
+			type.save(state, out);
+		}
+
+		f.write();
+	}
+
+	// loads into an ecs that has no entities and no registered groups, the caller holds a wview
+	// every saved type must be present in the registry with the same version and size
+	snapshot_error snapshot_load(ref<ecs> state, cref<snapshot_registry> registry, ref<core::file> f) {
+		JOLLY_ASSERT(state.entities.size == 0 && state.groups.size == 0, "snapshots load into an empty ecs");
+
+		core::vector<u8> data{}; // read allocates, value init keeps it from leaking
+		f.read(data);
+		snapshot_reader in(data);
+
+		snapshot_header header{};
+		if (!in.read(header)) return snapshot_error::truncated;
+		if (header.magic != SNAPSHOT_MAGIC) return snapshot_error::bad_magic;
+		if (header.version != SNAPSHOT_VERSION) return snapshot_error::bad_version;
+		if (header.types > ecs::MAX_POOLS) return snapshot_error::too_many_types;
+		in.align();
+
+		// validate everything before the ecs is touched
+		cptr<snapshot_type> types[ecs::MAX_POOLS];
+		for (u32 i : core::range(header.types)) {
+			snapshot_column column{};
+			if (!in.read(column)) return snapshot_error::truncated;
+
+			types[i] = registry.find(column.name);
+			if (!types[i]) return snapshot_error::unknown_type;
+			if (types[i]->version != column.version || types[i]->size != column.size) return snapshot_error::type_mismatch;
+		}
+		in.align();
+
+		u32 count = header.entities;
+		cptr<u8> entities = in.read((u64)count * sizeof(e_id));
+		in.align();
+		cptr<u8> signatures = in.read((u64)count * sizeof(u64));
+		in.align();
+		if (!entities || !signatures) return snapshot_error::truncated;
+		if (header.free != U32_MAX && header.free >= count) return snapshot_error::truncated;
+
+		// every column is walked once up front, a short file leaves the ecs untouched
+		// each entity must appear exactly in the columns its signature names
+		core::vector<u64> found(count);
+		found.size = count;
+		core::zero8((ptr<u8>)found.data, count * (u32)sizeof(u64));
+
+		u32 columns = in.offset;
+		for (u32 i : core::range(header.types)) {
+			snapshot_error error = types[i]->check(in, found.data, count, i);
+			if (error != snapshot_error::none) return error;
+		}
+		in.offset = columns;
+
+		cptr<u64> saved = (cptr<u64>)signatures;
+		for (u32 i : core::range(count)) {
+			if (found[i] != saved[i]) return snapshot_error::bad_entity;
+		}
+
+		u64 indices[ecs::MAX_POOLS];
+		for (u32 i : core::range(header.types)) {
+			indices[i] = types[i]->index(state);
+		}
+
+		if (state.entities.reserve < count) {
+			state.entities.resize(count);
+		}
+
+		if (state.bitset.reserve < count) {
+			state.bitset.resize(count);
+		}
+
+		state.entities.size = count;
+		core::copy8((ptr<u8>)entities, (ptr<u8>)state.entities.data, count * (u32)sizeof(e_id));
+
+		state.bitset.size = count;
+		for (u32 i : core::range(count)) {
+			u64 bits = saved[i];
+			u64 remapped = 0;
+			for (u32 j : core::range(header.types)) {
+				remapped |= ((bits >> j) & 1) << indices[j];
+			}
+
+			state.bitset[i] = remapped;
+		}
+
+		state.free = header.free;
+		state.tick = header.tick;
+
+		for (u32 i : core::range(header.types)) {
+			if (!types[i]->load(state, in)) return snapshot_error::truncated;
+		}
+
+		return snapshot_error::none;
+	}
+}
@@ -0,0 +1,486 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.spatial;
+import core.types;
+import core.vector;
+import core.table;
+import core.iterator;
+import core.operations;
+import core.lock;
+import math.vec;
+import jolly.ecs;
+import jolly.column;
+import jolly.components;
+
+export namespace jolly {
+	// quads are centered on pos and scale is the full extent
+	aabb2f quad_bounds(cref<quad_component> quad) {
+		math::vec2f half{ quad.scale.x * 0.5f, quad.scale.y * 0.5f };
+		return aabb2f{ { quad.pos.x - half.x, quad.pos.y - half.y }, { quad.pos.x + half.x, quad.pos.y + half.y } };
+	}
+
+	bool aabb_overlap(cref<aabb2f> a, cref<aabb2f> b) {
+		return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y;
+	}
+
+	bool aabb_circle(cref<aabb2f> box, math::vec2f center, f32 radius) {
+		f32 x = core::max(box.min.x, core::min(center.x, box.max.x)) - center.x;
+		f32 y = core::max(box.min.y, core::min(center.y, box.max.y)) - center.y;
+		return x * x + y * y <= radius * radius;
+	}
+
+	// slab test, inv_dir is 1 / dir per axis, hits within [0, tmax]
+	bool aabb_ray(cref<aabb2f> box, math::vec2f origin, math::vec2f inv_dir, f32 tmax) {
+		f32 tx1 = (box.min.x - origin.x) * inv_dir.x;
+		f32 tx2 = (box.max.x - origin.x) * inv_dir.x;
+		f32 ty1 = (box.min.y - origin.y) * inv_dir.y;
+		f32 ty2 = (box.max.y - origin.y) * inv_dir.y;
+
+		f32 tmin = core::max(core::min(tx1, tx2), core::min(ty1, ty2));
+		f32 tfar = core::min(core::max(tx1, tx2), core::max(ty1, ty2));
+		return tfar >= core::max(tmin, 0.0f) && tmin <= tmax;
+	}
+
+	struct spatial_entry {
+		aabb2f box;
+		u64 cell;
+		u32 prev; // neighbours in the cell's list, U32_MAX terminates
+		u32 next;
+	};
+
+	// loose uniform grid, an entry lives in the single cell holding its center and queries are
+	// grown by the largest half extent held, so moving an entry touches at most two cell lists
+	// entries are kept dense alongside a sparse_set, the same way pools are
+	struct spatial_grid {
+		spatial_grid(f32 size = 64.0f)
+		: set()
+		, entries(0)
+		, cells()
+		, cell_size(size)
+		, loose(0)
+		, largest(0) {}
+
+		void insert(e_id e, cref<aabb2f> box) {
+			set.add(e);
+			entries.add(spatial_entry{ box, _key(box), U32_MAX, U32_MAX });
+			_link(entries.size - 1);
+			_grow(box);
+		}
+
+		void remove(e_id e) {
+			u32 idx = set.index(e);
+			aabb2f old = entries[idx].box;
+			_unlink(idx);
+
+			// mirror the swap remove done by the set
+			u32 last = entries.size - 1;
+			if (idx != last) {
+				_unlink(last);
+				entries[idx] = entries[last];
+				_link(idx);
+			}
+
+			entries.size--;
+			set.del(e);
+			_forget(old);
+		}
+
+		void move(e_id e, cref<aabb2f> box) {
+			u32 idx = set.index(e);
+			u64 key = _key(box);
+			if (key != entries[idx].cell) {
+				_unlink(idx);
+				entries[idx].cell = key;
+				_link(idx);
+			}
+
+			aabb2f old = entries[idx].box;
+			entries[idx].box = box;
+			_grow(box);
+			_forget(old);
+		}
+
+		// the set only compares ids, a recycled id must not match the entry of its last owner
+		bool has(e_id e) const {
+			return set.has(e) && set.dense[set.index(e)]._id == e._id;
+		}
+
+		// fn(e_id) for every entry overlapping box
+		template<typename Fn>
+		void query(cref<aabb2f> box, Fn fn) const {
+			i32 x0 = _coord(box.min.x - loose), x1 = _coord(box.max.x + loose);
+			i32 y0 = _coord(box.min.y - loose), y1 = _coord(box.max.y + loose);
+
+			// huge boxes cover more cells than there are entries
+			u64 span = (u64)(x1 - x0 + 1) * (u64)(y1 - y0 + 1);
+			if (span > entries.size) {
+				for (u32 i : core::range(entries.size)) {
+					if (aabb_overlap(entries[i].box, box)) fn(set.dense[i]);
+				}
+				return;
+			}
+
+			for (i32 y = y0; y <= y1; y++) {
+				for (i32 x = x0; x <= x1; x++) {
+					u64 key = _pack(x, y);
+					if (!cells.has(key)) continue;
+
+					for (u32 i = cells.get(key); i != U32_MAX; i = entries[i].next) {
+						if (aabb_overlap(entries[i].box, box)) fn(set.dense[i]);
+					}
+				}
+			}
+		}
+
+		template<typename Fn>
+		void query_radius(math::vec2f center, f32 radius, Fn fn) const {
+			aabb2f box{ { center.x - radius, center.y - radius }, { center.x + radius, center.y + radius } };
+			query(box, [&](e_id e) {
+				if (aabb_circle(entries[set.index(e)].box, center, radius)) fn(e);
+			});
+		}
+
+		// dir does not need to be normalized, hits are within origin + dir * [0, tmax]
+		template<typename Fn>
+		void query_ray(math::vec2f origin, math::vec2f dir, f32 tmax, Fn fn) const {
+			math::vec2f end{ origin.x + dir.x * tmax, origin.y + dir.y * tmax };
+			aabb2f box{ { core::min(origin.x, end.x), core::min(origin.y, end.y) }, { core::max(origin.x, end.x), core::max(origin.y, end.y) } };
+			math::vec2f inv{ 1.0f / dir.x, 1.0f / dir.y };
+			query(box, [&](e_id e) {
+				if (aabb_ray(entries[set.index(e)].box, origin, inv, tmax)) fn(e);
+			});
+		}
+
+		i32 _coord(f32 v) const {
+			f32 c = v / cell_size;
+			i32 i = (i32)c;
+			return (c < 0 && (f32)i != c) ? i - 1 : i;
+		}
+
+		u64 _pack(i32 x, i32 y) const {
+			return ((u64)(u32)x << 32) | (u64)(u32)y;
+		}
+
+		u64 _key(cref<aabb2f> box) const {
+			return _pack(_coord((box.min.x + box.max.x) * 0.5f), _coord((box.min.y + box.max.y) * 0.5f));
+		}
+
+		f32 _half(cref<aabb2f> box) const {
+			return core::max(box.max.x - box.min.x, box.max.y - box.min.y) * 0.5f;
+		}
+
+		void _grow(cref<aabb2f> box) {
+			f32 half = _half(box);
+			if (half > loose) {
+				loose = half;
+				largest = 1;
+			} else if (half == loose) {
+				largest++;
+			}
+		}
+
+		// called once box has left the grid, loose is refit when its last holder is gone
+		void _forget(cref<aabb2f> box) {
+			if (_half(box) != loose || --largest) return;
+
+			loose = 0;
+			for (auto& entry : entries) {
+				_grow(entry.box);
+			}
+		}
+
+		void _link(u32 idx) {
+			auto& entry = entries[idx];
+			entry.prev = U32_MAX;
+			entry.next = cells.has(entry.cell) ? cells.get(entry.cell) : U32_MAX;
+			if (entry.next != U32_MAX) entries[entry.next].prev = idx;
+			cells.set(entry.cell, idx);
+		}
+
+		void _unlink(u32 idx) {
+			auto& entry = entries[idx];
+			if (entry.next != U32_MAX) entries[entry.next].prev = entry.prev;
+			if (entry.prev != U32_MAX) {
+				entries[entry.prev].next = entry.next;
+			} else if (entry.next != U32_MAX) {
+				cells.set(entry.cell, entry.next);
+			} else {
+				cells.del(entry.cell);
+			}
+		}
+
+		sparse_set set;
+		core::vector<spatial_entry> entries;
+		core::table<u64, u32> cells; // head of each cell's list
+		f32 cell_size;
+		f32 loose;
+		u32 largest; // entries whose half extent is loose
+	};
+
+	struct bvh_node {
+		aabb2f box;
+		u32 first; // first child for inner nodes, first item for leaves
+		u32 count; // 0 for inner nodes
+	};
+
+	// static bvh over the grid's entries, rebuilt in bulk with median splits on the longest axis
+	// better than the grid for long rays and very uneven sizes, worse for frequent movement
+	struct spatial_bvh {
+		static constexpr u32 LEAF_SIZE = 4;
+
+		spatial_bvh()
+		: nodes(0)
+		, items(0)
+		, boxes(0) {}
+
+		void build(cref<spatial_grid> grid) {
+			u32 count = grid.entries.size;
+			nodes.size = 0;
+			items.size = 0;
+			boxes.size = 0;
+			if (!count) return;
+
+			// indices are sorted, items and boxes are laid out in leaf order at the end
+			core::vector<aabb2f> src(count);
+			for (u32 i : core::range(count)) {
+				src.add(grid.entries[i].box);
+			}
+
+			core::vector<u32> scratch(count);
+			core::vector<u32> order(count);
+			for (u32 i : core::range(count)) {
+				order.add(i);
+			}
+
+			struct task { u32 node; u32 beg; u32 end; };
+			core::vector<task> stack(core::BLOCK_64);
+			nodes.add();
+			stack.add(task{ 0, 0, count });
+
+			while (stack.size) {
+				task t = stack[--stack.size];
+				aabb2f box = src[order[t.beg]];
+				for (u32 i : core::range(t.beg + 1, t.end)) {
+					cref<aabb2f> b = src[order[i]];
+					box.min.x = core::min(box.min.x, b.min.x);
+					box.min.y = core::min(box.min.y, b.min.y);
+					box.max.x = core::max(box.max.x, b.max.x);
+					box.max.y = core::max(box.max.y, b.max.y);
+				}
+
+				nodes[t.node].box = box;
+				u32 n = t.end - t.beg;
+				if (n <= LEAF_SIZE) {
+					nodes[t.node].first = t.beg;
+					nodes[t.node].count = n;
+					continue;
+				}
+
+				bool xaxis = (box.max.x - box.min.x) >= (box.max.y - box.min.y);
+				auto less = [&](u32 a, u32 b) {
+					cref<aabb2f> ba = src[a];
+					cref<aabb2f> bb = src[b];
+					return xaxis ? (ba.min.x + ba.max.x) < (bb.min.x + bb.max.x) : (ba.min.y + ba.max.y) < (bb.min.y + bb.max.y);
+				};
+				core::merge_sort(order.data + t.beg, scratch.data, n, less);
+
+				u32 left = nodes.size;
+				nodes.add();
+				nodes.add();
+				nodes[t.node].first = left;
+				nodes[t.node].count = 0;
+
+				u32 mid = t.beg + n / 2;
+				stack.add(task{ left, t.beg, mid });
+				stack.add(task{ left + 1, mid, t.end });
+			}
+
+			for (u32 i : core::range(count)) {
+				items.add(grid.set.dense[order[i]]);
+				boxes.add(src[order[i]]);
+			}
+		}
+
+		// test(box) decides whether a node or item is visited
+		template<typename Test, typename Fn>
+		void _walk(Test test, Fn fn) const {
+			if (!nodes.size) return;
+
+			u32 stack[core::BLOCK_64];
+			u32 top = 0;
+			stack[top++] = 0;
+			while (top) {
+				cref<bvh_node> node = nodes[stack[--top]];
+				if (!test(node.box)) continue;
+
+				if (node.count) {
+					for (u32 i : core::range(node.first, node.first + node.count)) {
+						if (test(boxes[i])) fn(items[i]);
+					}
+				} else {
+					stack[top++] = node.first;
+					stack[top++] = node.first + 1;
+				}
+			}
+		}
+
+		template<typename Fn>
+		void query(cref<aabb2f> box, Fn fn) const {
+			_walk([&](cref<aabb2f> b) { return aabb_overlap(b, box); }, fn);
+		}
+
+		template<typename Fn>
+		void query_radius(math::vec2f center, f32 radius, Fn fn) const {
+			_walk([&](cref<aabb2f> b) { return aabb_circle(b, center, radius); }, fn);
+		}
+
+		template<typename Fn>
+		void query_ray(math::vec2f origin, math::vec2f dir, f32 tmax, Fn fn) const {
+			math::vec2f inv{ 1.0f / dir.x, 1.0f / dir.y };
+			_walk([&](cref<aabb2f> b) { return aabb_ray(b, origin, inv, tmax); }, fn);
+		}
+
+		core::vector<bvh_node> nodes;
+		core::vector<e_id> items;
+		core::vector<aabb2f> boxes;
+	};
+
+	enum class spatial_mode {
+		grid = 0,
+		bvh,
+	};
+
+	// spatial index over quad_component, shared by culling, broadphase and hit testing
+	// update runs at a sync point and only looks at quads removed or stamped since the last
+	// update, position changes must go through ecs::patch to be seen
+	// the index is bound to the first ecs it updates from, which has to outlive it, and must
+	// not move after that since its del observer points at it
+	struct spatial_index {
+		spatial_index(spatial_mode in = spatial_mode::grid, f32 cell_size = 64.0f)
+		: grid(cell_size)
+		, bvh()
+		, mode(in)
+		, since(0)
+		, dirty(false)
+		, removed(0)
+		, state(nullptr)
+		, observer(0) {}
+
+		spatial_index(cref<spatial_index> other) = delete;
+
+		~spatial_index() {
+			if (state) state->unobserve(observer);
+		}
+
+		// the caller holds a wview of the ecs
+		void update(ref<ecs> in) {
+			if (!state) _bind(in);
+			JOLLY_ASSERT(state == &in, "spatial index updated from another ecs");
+
+			// removals first, an entity that lost its quad and got a new one this tick is
+			// removed here and inserted again below
+			for (e_id e : removed) {
+				if (!grid.has(e)) continue;
+				grid.remove(e);
+				dirty = true;
+			}
+
+			removed.size = 0;
+
+			for (auto [e, quad] : in.filter<changed<quad_component>>(since)) {
+				aabb2f box = quad_bounds(*quad.data);
+				if (grid.has(e)) {
+					grid.move(e, box);
+				} else {
+					if (grid.set.has(e)) grid.remove(grid.set.dense[grid.set.index(e)]);
+					grid.insert(e, box);
+				}
+
+				dirty = true;
+			}
+
+			since = in.advance();
+			if (mode == spatial_mode::bvh && dirty) {
+				bvh.build(grid);
+			}
+
+			dirty = false;
+		}
+
+		void _bind(ref<ecs> in) {
+			auto on_del = [](ptr<void> user, ref<ecs> state, cptr<e_id> e, u32 count, ecs_event event) {
+				auto& index = *(ptr<spatial_index>)user;
+				for (u32 i : core::range(count)) {
+					index.removed.add(e[i]);
+				}
+			};
+
+			state = &in;
+			observer = in.observe<quad_component>(ecs_event::del, on_del, this);
+			if (!in.view<quad_component>().tracked()) {
+				in.track<quad_component>();
+			}
+		}
+
+		template<typename Fn>
+		void query(cref<aabb2f> box, Fn fn) const {
+			if (mode == spatial_mode::bvh) {
+				bvh.query(box, fn);
+			} else {
+				grid.query(box, fn);
+			}
+		}
+
+		template<typename Fn>
+		void query_radius(math::vec2f center, f32 radius, Fn fn) const {
+			if (mode == spatial_mode::bvh) {
+				bvh.query_radius(center, radius, fn);
+			} else {
+				grid.query_radius(center, radius, fn);
+			}
+		}
+
+		template<typename Fn>
+		void query_ray(math::vec2f origin, math::vec2f dir, f32 tmax, Fn fn) const {
+			if (mode == spatial_mode::bvh) {
+				bvh.query_ray(origin, dir, tmax, fn);
+			} else {
+				grid.query_ray(origin, dir, tmax, fn);
+			}
+		}
+
+		// batched forms, fn(query index, e_id)
+		template<typename Fn>
+		void query_n(core::span<aabb2f> boxes, Fn fn) const {
+			for (u32 i : core::range(boxes.size)) {
+				query(boxes[i], [&](e_id e) { fn(i, e); });
+			}
+		}
+
+		template<typename Fn>
+		void query_radius_n(core::span<math::vec2f> centers, f32 radius, Fn fn) const {
+			for (u32 i : core::range(centers.size)) {
+				query_radius(centers[i], radius, [&](e_id e) { fn(i, e); });
+			}
+		}
+
+		template<typename Fn>
+		void query_ray_n(core::span<math::vec2f> origins, core::span<math::vec2f> dirs, f32 tmax, Fn fn) const {
+			JOLLY_ASSERT(origins.size == dirs.size, "ray origin and direction counts differ");
+			for (u32 i : core::range(origins.size)) {
+				query_ray(origins[i], dirs[i], tmax, [&](e_id e) { fn(i, e); });
+			}
+		}
+
+		spatial_grid grid;
+		spatial_bvh bvh;
+		spatial_mode mode;
+		u32 since;
+		bool dirty;
+		core::vector<e_id> removed; // filled by the del observer between updates
+		ptr<ecs> state;
+		u32 observer;
+	};
+}
@@ -0,0 +1,359 @@
+module;
+
+#include <core/core.h>
+#include <immintrin.h>
+#include <math.h>
+
+export module jolly.transform;
+import core.types;
+import core.vector;
+import core.simd;
+import core.iterator;
+import core.lock;
+import math.vec;
+import jolly.ecs;
+import jolly.components;
+import jolly.parallel;
+
+export namespace jolly {
+	// 2d affine matrix, x' = a * x + c * y + tx, y' = b * x + d * y + ty
+	// stored as six float columns so eight nodes are composed per avx step
+	struct affine_soa {
+		affine_soa()
+		: a(0), b(0), c(0), d(0), tx(0), ty(0) {}
+
+		void clear() {
+			a.size = b.size = c.size = d.size = tx.size = ty.size = 0;
+		}
+
+		void add(f32 in_a, f32 in_b, f32 in_c, f32 in_d, f32 in_tx, f32 in_ty) {
+			a.add(in_a);
+			b.add(in_b);
+			c.add(in_c);
+			d.add(in_d);
+			tx.add(in_tx);
+			ty.add(in_ty);
+		}
+
+		void set(u32 idx, cref<transform_component> t) {
+			f32 cs = cosf(t.rotation);
+			f32 sn = sinf(t.rotation);
+			a[idx] = cs * t.scale.x;
+			b[idx] = sn * t.scale.x;
+			c[idx] = -sn * t.scale.y;
+			d[idx] = cs * t.scale.y;
+			tx[idx] = t.pos.x;
+			ty[idx] = t.pos.y;
+		}
+
+		core::vector<f32> a, b, c, d, tx, ty;
+	};
+
+	// world[i] = world[parent[i]] * local[i] for i in [beg, end), parents are already final
+	void compose_affine(ref<affine_soa> world, cref<affine_soa> local, cptr<u32> parent, u32 beg, u32 end) {
+		u32 i = beg;
+		for (; i + 8 <= end; i += 8) {
+			__m256i p = _mm256_loadu_si256((cptr<__m256i>)(parent + i));
+			__m256 pa = _mm256_i32gather_ps(world.a.data, p, 4);
+			__m256 pb = _mm256_i32gather_ps(world.b.data, p, 4);
+			__m256 pc = _mm256_i32gather_ps(world.c.data, p, 4);
+			__m256 pd = _mm256_i32gather_ps(world.d.data, p, 4);
+			__m256 ptx = _mm256_i32gather_ps(world.tx.data, p, 4);
+			__m256 pty = _mm256_i32gather_ps(world.ty.data, p, 4);
+
+			__m256 la = _mm256_loadu_ps(local.a.data + i);
+			__m256 lb = _mm256_loadu_ps(local.b.data + i);
+			__m256 lc = _mm256_loadu_ps(local.c.data + i);
+			__m256 ld = _mm256_loadu_ps(local.d.data + i);
+			__m256 ltx = _mm256_loadu_ps(local.tx.data + i);
+			__m256 lty = _mm256_loadu_ps(local.ty.data + i);
+
+			_mm256_storeu_ps(world.a.data + i, _mm256_add_ps(_mm256_mul_ps(pa, la), _mm256_mul_ps(pc, lb)));
+			_mm256_storeu_ps(world.b.data + i, _mm256_add_ps(_mm256_mul_ps(pb, la), _mm256_mul_ps(pd, lb)));
+			_mm256_storeu_ps(world.c.data + i, _mm256_add_ps(_mm256_mul_ps(pa, lc), _mm256_mul_ps(pc, ld)));
+			_mm256_storeu_ps(world.d.data + i, _mm256_add_ps(_mm256_mul_ps(pb, lc), _mm256_mul_ps(pd, ld)));
+			_mm256_storeu_ps(world.tx.data + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pa, ltx), _mm256_mul_ps(pc, lty)), ptx));
+			_mm256_storeu_ps(world.ty.data + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(pb, ltx), _mm256_mul_ps(pd, lty)), pty));
+		}
+
+		for (; i < end; i++) {
+			u32 p = parent[i];
+			f32 pa = world.a[p], pb = world.b[p], pc = world.c[p], pd = world.d[p];
+			world.a[i] = pa * local.a[i] + pc * local.b[i];
+			world.b[i] = pb * local.a[i] + pd * local.b[i];
+			world.c[i] = pa * local.c[i] + pc * local.d[i];
+			world.d[i] = pb * local.c[i] + pd * local.d[i];
+			world.tx[i] = pa * local.tx[i] + pc * local.ty[i] + world.tx[p];
+			world.ty[i] = pb * local.tx[i] + pd * local.ty[i] + world.ty[p];
+		}
+	}
+
+	enum class transform_error {
+		none = 0,
+		cycle, // some parent chains loop, those nodes are left out until the loop is broken
+	};
+
+	// keeps every transform_component grouped by root, each root's subtree is one contiguous
+	// range in breadth first order, so subtrees propagate independently and each depth inside
+	// one is a contiguous range
+	// node 0 is an identity root every real root hangs off
+	struct transform_system {
+		static constexpr u32 BLOCK = 8; // nodes per avx step
+
+		transform_system()
+		: set()
+		, parent(0)
+		, levels(0)
+		, roots(0)
+		, local()
+		, world()
+		, dirty(0)
+		, since(0)
+		, versions{ U32_MAX, U32_MAX } {}
+
+		// the caller holds a wview of the ecs, world transforms are written to quad_component
+		// local changes and reparenting must go through ecs::patch to be seen
+		// returns cycle on the update that lays out a hierarchy holding one
+		transform_error update(ref<ecs> state) {
+			auto& transforms = state.view<transform_component>();
+			auto& hierarchy = state.view<hierarchy_component>();
+			if (!transforms.tracked()) {
+				state.track<transform_component>();
+			}
+
+			if (!hierarchy.tracked()) {
+				state.track<hierarchy_component>();
+			}
+
+			transform_error result = transform_error::none;
+			bool reparented = false;
+			for (auto [e, h] : state.filter<changed<hierarchy_component>>(since)) {
+				reparented = true;
+				break;
+			}
+
+			if (reparented || transforms.version != versions[0] || hierarchy.version != versions[1]) {
+				result = _rebuild(state);
+				versions[0] = transforms.version;
+				versions[1] = hierarchy.version;
+			} else {
+				for (auto [e, t] : state.filter<changed<transform_component>>(since)) {
+					if (!set.has(e)) continue;
+					u32 idx = set.index(e) + 1;
+					local.set(idx, *t.data);
+					dirty[idx] = 1;
+				}
+			}
+
+			since = state.advance();
+			_propagate();
+			_write(state);
+			return result;
+		}
+
+		transform_error _rebuild(ref<ecs> state) {
+			auto& transforms = state.view<transform_component>();
+			auto& hierarchy = state.view<hierarchy_component>();
+			u32 count = transforms.set.dense.size;
+
+			// children lists in compressed form, indexed by dense index in the transform pool
+			core::vector<u32> owner(count);
+			core::vector<u32> offsets(count + 2);
+			for (u32 i : core::range(count + 2)) {
+				offsets.add(0);
+			}
+
+			for (u32 i : core::range(count)) {
+				e_id e = transforms.set.dense[i];
+				u32 p = U32_MAX;
+				if (hierarchy.has(e)) {
+					// a destroyed parent's id may be recycled, the generation has to match too
+					e_id pe = hierarchy.get(e).parent;
+					u32 idx = transforms.set.index(pe);
+					if (idx != U32_MAX && transforms.set.dense[idx]._id == pe._id) p = idx;
+				}
+
+				owner.add(p);
+				offsets[(p == U32_MAX ? count : p) + 1]++;
+			}
+
+			for (u32 i : core::range(count + 1)) {
+				offsets[i + 1] += offsets[i];
+			}
+
+			core::vector<u32> children(count);
+			children.size = count;
+			core::vector<u32> cursor(count + 1);
+			for (u32 i : core::range(count + 1)) {
+				cursor.add(offsets[i]);
+			}
+
+			for (u32 i : core::range(count)) {
+				u32 p = owner[i] == U32_MAX ? count : owner[i];
+				children[cursor[p]++] = i;
+			}
+
+			// breadth first from each root in turn, count is the virtual root's slot in the lists
+			// nodes on a parent cycle are never reached from a root and are left out
+			core::vector<u32> order(count);
+			core::vector<u32> node_parent(count);
+			levels.size = 0;
+			roots.size = 0;
+			levels.add(1);
+			for (u32 r : core::range(offsets[count], offsets[count + 1])) {
+				roots.add(levels.size - 1);
+
+				u32 head = order.size;
+				order.add(children[r]);
+				node_parent.add(0);
+				while (head < order.size) {
+					u32 level_end = order.size;
+					levels.add(level_end + 1);
+					for (; head < level_end; head++) {
+						u32 n = order[head];
+						for (u32 i : core::range(offsets[n], offsets[n + 1])) {
+							order.add(children[i]);
+							node_parent.add(head + 1);
+						}
+					}
+				}
+			}
+
+			roots.add(levels.size - 1);
+
+			// the set's dense order matches the node order, node = set.index(e) + 1
+			while (set.dense.size) {
+				set.del(set.dense[set.dense.size - 1]);
+			}
+
+			parent.size = 0;
+			dirty.size = 0;
+			local.clear();
+			world.clear();
+
+			parent.add(0);
+			dirty.add(0);
+			local.add(1, 0, 0, 1, 0, 0);
+			world.add(1, 0, 0, 1, 0, 0);
+
+			for (u32 i : core::range(order.size)) {
+				e_id e = transforms.set.dense[order[i]];
+				set.add(e);
+				parent.add(node_parent[i]);
+				dirty.add(1);
+				local.add(0, 0, 0, 0, 0, 0);
+				world.add(0, 0, 0, 0, 0, 0);
+				local.set(i + 1, transforms.components[order[i]]);
+			}
+
+			return order.size == count ? transform_error::none : transform_error::cycle;
+		}
+
+		// subtrees are independent, workers take whole subtrees split by node count
+		// a single root has nothing to split by, its wide levels are split instead
+		void _propagate() {
+			u32 subtrees = roots.size - 1;
+			if (subtrees == 1) {
+				_subtree(0, true);
+				return;
+			}
+
+			auto body = [&](u32 chunk, u32 b, u32 e) {
+				// a chunk owns the subtrees starting in it, the rest of its range may belong to
+				// a subtree started by an earlier chunk
+				u32 lo = 0;
+				u32 hi = subtrees;
+				while (lo < hi) {
+					u32 mid = (lo + hi) / 2;
+					if (levels[roots[mid]] < b + 1) lo = mid + 1;
+					else hi = mid;
+				}
+
+				for (u32 s = lo; s < subtrees && levels[roots[s]] < e + 1; s++) {
+					_subtree(s, false);
+				}
+			};
+
+			u32 count = dirty.size - 1;
+			if (count < PAR_MIN_CHUNK) {
+				body(0, 0, count);
+			} else {
+				_par_run(count, par_chunk_size(count, BLOCK, par_workers()), body);
+			}
+		}
+
+		// depths of one subtree in order, dirty flags flow down before a depth is composed
+		void _subtree(u32 s, bool wide) {
+			for (u32 l : core::range(roots[s], roots[s + 1])) {
+				u32 beg = levels[l];
+				u32 end = levels[l + 1];
+
+				// a clean node under a clean parent keeps its world transform
+				bool any = false;
+				for (u32 i : core::range(beg, end)) {
+					dirty[i] |= dirty[parent[i]];
+					any |= dirty[i] != 0;
+				}
+
+				if (!any) continue;
+				if (wide) {
+					_compose(beg, end);
+				} else {
+					_blocks(beg, end);
+				}
+			}
+		}
+
+		// nodes on one depth are independent, wide depths are split across workers
+		void _compose(u32 beg, u32 end) {
+			auto body = [&](u32 chunk, u32 b, u32 e) {
+				_blocks(beg + b, beg + e);
+			};
+
+			u32 count = end - beg;
+			if (count < PAR_MIN_CHUNK) {
+				body(0, 0, count);
+			} else {
+				_par_run(count, par_chunk_size(count, BLOCK, par_workers()), body);
+			}
+		}
+
+		void _blocks(u32 beg, u32 end) {
+			for (u32 i = beg; i < end; i += BLOCK) {
+				u32 last = core::min(i + BLOCK, end);
+				bool any = false;
+				for (u32 j : core::range(i, last)) {
+					any |= dirty[j] != 0;
+				}
+
+				if (any) compose_affine(world, local, parent.data, i, last);
+			}
+		}
+
+		void _write(ref<ecs> state) {
+			auto& quads = state.view<quad_component>();
+			auto view = core::wview_create(quads);
+			for (u32 i : core::range(1, dirty.size)) {
+				if (!dirty[i]) continue;
+				dirty[i] = 0;
+
+				e_id e = set.dense[i - 1];
+				if (!quads.has(e)) continue;
+
+				auto& quad = quads.patch(e);
+				quad.pos = math::vec2f{ world.tx[i], world.ty[i] };
+				quad.scale = math::vec2f{ sqrtf(world.a[i] * world.a[i] + world.b[i] * world.b[i]), sqrtf(world.c[i] * world.c[i] + world.d[i] * world.d[i]) };
+			}
+		}
+
+		sparse_set set;
+		core::vector<u32> parent; // node index of the parent, 0 for roots
+		core::vector<u32> levels; // depth boundaries, depth i covers [levels[i], levels[i + 1])
+		core::vector<u32> roots; // subtree s owns depths [roots[s], roots[s + 1])
+		affine_soa local;
+		affine_soa world;
+		core::vector<u8> dirty;
+		u32 since;
+		u32 versions[2];
+	};
+}
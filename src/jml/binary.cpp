@@ -0,0 +1,157 @@
+module;
+
+#include <core/core.h>
+
+module jolly.jml;
+
+// binary jml is the parsed tape written out as is, the node, slot and string arrays are used
+// in place, opening one walks every node and slot once so no accessor can leave the image
+
+namespace jolly {
+	bool jml_section(u64 offset, u64 bytes, u64 align, u32 size) {
+		return offset % align == 0 && offset + bytes <= size;
+	}
+
+	bool jml_in_bounds(u32 offset, u32 bytes, u32 size) {
+		return (u64)offset + bytes <= size;
+	}
+
+	// keys and strings stay inside the string section, containers end past themselves and
+	// inside the image, slots point at real nodes and at least one is empty so probing terminates
+	bool jml_validate(cref<jml_header> header, cptr<jml_node> nodes, cptr<jml_slot> slots) {
+		if (!header.node_count) return false;
+		if (!header.slot_count && header.node_count > 1) return false;
+		if ((jml_type)nodes[0].type != jml_type::tbl) return false;
+
+		for (u32 n : core::range(header.node_count)) {
+			auto& node = nodes[n];
+			if (!jml_in_bounds(node.key, node.key_size, header.string_bytes)) return false;
+
+			switch ((jml_type)node.type) {
+				case jml_type::num:
+				case jml_type::boolean: break;
+				case jml_type::str: {
+					// pooled and source strings share the one section
+					if (!jml_in_bounds(node.str.offset, node.str.size & ~JML_POOLED, header.string_bytes)) return false;
+					break;
+				}
+				case jml_type::arr:
+				case jml_type::tbl: {
+					if (node.children.end <= n || node.children.end > header.node_count) return false;
+					break;
+				}
+				default: return false;
+			}
+		}
+
+		bool empty = !header.slot_count;
+		for (u32 i : core::range(header.slot_count)) {
+			if (slots[i].node >= header.node_count) return false;
+			empty |= !slots[i].node;
+		}
+
+		return empty;
+	}
+
+	jml_result jml_open(ref<jml_image> image, fwd<core::file_map> file) {
+		image.file = forward_data(file);
+		image.node_data = nullptr;
+		image.string_data = nullptr;
+		image.pool_data = nullptr;
+		image.slot_data = nullptr;
+		image.node_count = 0;
+		image.slot_count = 0;
+
+		cptr<u8> data = image.file.data;
+		u32 size = image.file.size;
+		if (!data) return jml_result{ jml_error::io, 0 };
+		if (!jml_binary(data, size)) return jml_result{ jml_error::bad_image, 0 };
+
+		cref<jml_header> header = *(cptr<jml_header>)data;
+		bool valid = header.version == JML_VERSION;
+		valid &= (header.slot_count & (header.slot_count - 1)) == 0;
+		valid &= jml_section(header.nodes, (u64)header.node_count * sizeof(jml_node), alignof(jml_node), size);
+		valid &= jml_section(header.slots, (u64)header.slot_count * sizeof(jml_slot), alignof(jml_slot), size);
+		valid &= jml_section(header.strings, header.string_bytes, 1, size);
+		if (!valid) return jml_result{ jml_error::bad_image, 0 };
+
+		cptr<jml_node> nodes = (cptr<jml_node>)(data + header.nodes);
+		cptr<jml_slot> slots = (cptr<jml_slot>)(data + header.slots);
+		if (!jml_validate(header, nodes, slots)) return jml_result{ jml_error::bad_image, 0 };
+
+		image.node_data = nodes;
+		image.slot_data = slots;
+		image.string_data = (cptr<char>)(data + header.strings);
+		image.pool_data = image.string_data;
+		image.node_count = header.node_count;
+		image.slot_count = header.slot_count;
+		return jml_result{ jml_error::none, 0 };
+	}
+
+	jml_result jml_open(ref<jml_image> image, core::stringview path) {
+		return jml_open(image, core::file_map(path));
+	}
+
+	// keys and strings are gathered out of the source and the pool, comments, whitespace and
+	// the rest of the text are left behind
+	jml_result jml_save(cref<jml_tape> tape, core::stringview path) {
+		core::vector<jml_node> nodes(tape.nodes.size);
+		core::vector<char> strings(0);
+		auto gather = [&](core::stringview str) {
+			u32 offset = strings.size;
+			if (strings.reserve < offset + str.size) {
+				strings.resize(core::max<u32>(strings.reserve * 2, offset + str.size));
+			}
+
+			core::copy8((ptr<u8>)str.data, (ptr<u8>)&strings[offset], str.size);
+			strings.size += str.size;
+			return offset;
+		};
+
+		for (u32 n : core::range(tape.nodes.size)) {
+			jml_node& node = nodes.add();
+			node = tape.nodes[n];
+			node.key = gather(tape.key(n));
+			if (tape.type(n) != jml_type::str) continue;
+
+			core::stringview str = tape.str(n);
+			node.str = jml_span{ gather(str), str.size };
+		}
+
+		jml_header header{};
+		header.magic = JML_MAGIC;
+		header.version = JML_VERSION;
+		header.node_count = nodes.size;
+		header.slot_count = tape.index.size;
+		header.string_bytes = strings.size;
+		header.nodes = sizeof(jml_header);
+		header.slots = header.nodes + header.node_count * sizeof(jml_node);
+		header.strings = header.slots + header.slot_count * sizeof(jml_slot);
+
+		core::membuf parts[] = {
+			core::membuf{ (ptr<u8>)&header, sizeof(jml_header) },
+			core::membuf{ (ptr<u8>)nodes.data, header.node_count * (u32)sizeof(jml_node) },
+			core::membuf{ (ptr<u8>)tape.index.data, header.slot_count * (u32)sizeof(jml_slot) },
+			core::membuf{ (ptr<u8>)strings.data, header.string_bytes },
+		};
+
+		auto f = core::fopen(path, core::access::wo | core::access::trunc);
+		u32 written = 0;
+		for (auto& part : parts) {
+			if (!part.size) continue;
+			auto bytes = f.write(part);
+			if (bytes) written += bytes.get();
+		}
+
+		f.write();
+		bool complete = written == header.strings + header.string_bytes;
+		return jml_result{ complete ? jml_error::none : jml_error::io, 0 };
+	}
+
+	jml_result jml_convert(core::stringview src, core::stringview dst) {
+		jml_tape tape;
+		jml_result res = jml_load(tape, src);
+		if (res.error != jml_error::none) return res;
+		return jml_save(tape, dst);
+	}
+}
@@ -0,0 +1,170 @@
+module;
+
+#include <core/core.h>
+
+export module jolly.jml_bind;
+import core.types;
+import core.string;
+import core.iterator;
+import math.vec;
+import jolly.jml;
+
+// binds jml tables to plain structs, a struct lists its fields once in a jml_schema
+// specialization and each field is written by a function chosen from its member type
+// field names are hashed at compile time and combined with the table's path hash, so binding
+// costs one lookup per field however many other entries the table holds and hashes no names
+//
+// template <>
+// struct jml_schema<ui_defaults> {
+//     static constexpr jml_field fields[] = {
+//         jml_bind<&ui_defaults::background>("background"),
+//         jml_bind<&ui_defaults::text_font>("text_font"),
+//     };
+// };
+
+export namespace jolly {
+	// hash is the path hash of n, nested tables continue it
+	typedef bool (*pfn_jml_assign)(cref<jml_view> src, u32 n, u64 hash, ptr<void> out);
+
+	struct jml_field {
+		cstr name;
+		u32 size;
+		u64 hash; // jml_hash_key of name
+		pfn_jml_assign assign;
+	};
+
+	// specialize with a static constexpr array of jml_field named fields
+	template <typename T>
+	struct jml_schema;
+
+	template <typename T>
+	u32 jml_bind_table(cref<jml_view> src, u32 table, u64 scope, ref<T> out);
+
+	// readers return false and leave out alone when the node has the wrong type
+	bool jml_read(cref<jml_view> src, u32 n, ref<f64> out) {
+		if (src.type(n) != jml_type::num) return false;
+		out = src.num(n);
+		return true;
+	}
+
+	bool jml_read(cref<jml_view> src, u32 n, ref<f32> out) {
+		if (src.type(n) != jml_type::num) return false;
+		out = (f32)src.num(n);
+		return true;
+	}
+
+	bool jml_read(cref<jml_view> src, u32 n, ref<i32> out) {
+		if (src.type(n) != jml_type::num) return false;
+		out = (i32)src.num(n);
+		return true;
+	}
+
+	bool jml_read(cref<jml_view> src, u32 n, ref<u32> out) {
+		if (src.type(n) != jml_type::num) return false;
+		out = (u32)src.num(n);
+		return true;
+	}
+
+	bool jml_read(cref<jml_view> src, u32 n, ref<bool> out) {
+		if (src.type(n) != jml_type::boolean) return false;
+		out = src.boolean(n);
+		return true;
+	}
+
+	bool jml_read(cref<jml_view> src, u32 n, ref<core::string> out) {
+		if (src.type(n) != jml_type::str) return false;
+		out = src.str(n);
+		return true;
+	}
+
+	// the first count elements, vectors are read through their consecutive members
+	template <typename T>
+	bool jml_read_items(cref<jml_view> src, u32 n, ptr<T> items, u32 count) {
+		if (src.type(n) != jml_type::arr || src.size(n) < count) return false;
+
+		u32 i = 0;
+		for (u32 c = src.first(n); i < count; c = src.next(c), i++) {
+			if (!jml_read(src, c, items[i])) return false;
+		}
+
+		return true;
+	}
+
+	template <typename T>
+	bool jml_read(cref<jml_view> src, u32 n, ref<math::vec2<T>> out) {
+		return jml_read_items(src, n, &out.x, 2);
+	}
+
+	template <typename T>
+	bool jml_read(cref<jml_view> src, u32 n, ref<math::vec3<T>> out) {
+		return jml_read_items(src, n, &out.x, 3);
+	}
+
+	template <typename T>
+	bool jml_read(cref<jml_view> src, u32 n, ref<math::vec4<T>> out) {
+		return jml_read_items(src, n, &out.x, 4);
+	}
+
+	// nested structs need their own schema
+	template <typename T>
+	bool jml_read(cref<jml_view> src, u32 n, u64 hash, ref<T> out) {
+		if (src.type(n) != jml_type::tbl) return false;
+		jml_bind_table(src, n, hash, out);
+		return true;
+	}
+
+	template <typename T>
+	struct jml_member;
+
+	template <typename T, typename M>
+	struct jml_member<M T::*> {
+		using owner = T;
+		using type = M;
+	};
+
+	template <auto Member>
+	bool jml_assign(cref<jml_view> src, u32 n, u64 hash, ptr<void> out) {
+		using owner = typename jml_member<decltype(Member)>::owner;
+		using type = typename jml_member<decltype(Member)>::type;
+		if constexpr (requires { jml_schema<type>::fields; }) {
+			return jml_read(src, n, hash, ((ptr<owner>)out)->*Member);
+		} else {
+			return jml_read(src, n, ((ptr<owner>)out)->*Member);
+		}
+	}
+
+	template <auto Member, u32 N>
+	consteval jml_field jml_bind(const char (&name)[N]) {
+		return jml_field{ name, N - 1, jml_hash_key(name, N - 1), &jml_assign<Member> };
+	}
+
+	// table is the node at path hash scope, JML_HASH_SEED for the root
+	// entries that are not fields or have the wrong type are skipped, fields without an entry
+	// keep their value, returns how many fields were written
+	template <typename T>
+	u32 jml_bind_table(cref<jml_view> src, u32 table, u64 scope, ref<T> out) {
+		if (src.type(table) != jml_type::tbl) return 0;
+
+		u32 count = 0;
+		for (auto& field : jml_schema<T>::fields) {
+			u64 hash = jml_hash_combine(scope, field.hash);
+			u32 n = src.lookup(hash, core::stringview(field.name, field.size));
+			if (n == JML_NONE) continue;
+			count += field.assign(src, n, hash, &out) ? 1 : 0;
+		}
+
+		return count;
+	}
+
+	// path is a dotted key path, an empty path binds the root
+	template <typename T>
+	u32 jml_bind_path(cref<jml_view> src, core::stringview path, ref<T> out) {
+		if (!src.node_count) return 0;
+		if (!path.size) return jml_bind_table(src, 0, JML_HASH_SEED, out);
+
+		jml_path key(path);
+		u32 n = src.find(key);
+		if (n == JML_NONE) return 0;
+		return jml_bind_table(src, n, key.hash, out);
+	}
+}
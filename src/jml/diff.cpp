@@ -0,0 +1,118 @@
+module;
+
+#include <core/core.h>
+
+module jolly.jml;
+
+// the newer document is walked table by table, every entry is matched to the older one through
+// the path index, so nothing is sorted or copied and unchanged tables cost one lookup per entry
+
+namespace jolly {
+	bool jml_equal(cref<jml_view> a, u32 an, cref<jml_view> b, u32 bn) {
+		if (a.type(an) != b.type(bn)) return false;
+		switch (a.type(an)) {
+			case jml_type::num: return a.num(an) == b.num(bn);
+			case jml_type::boolean: return a.boolean(an) == b.boolean(bn);
+			case jml_type::str: return a.str(an) == b.str(bn);
+			case jml_type::arr: {
+				if (a.size(an) != b.size(bn)) return false;
+				u32 bc = b.first(bn);
+				for (u32 ac = a.first(an); ac < a.end(an); ac = a.next(ac), bc = b.next(bc)) {
+					if (!jml_equal(a, ac, b, bc)) return false;
+				}
+
+				return true;
+			}
+			default: return true;
+		}
+	}
+
+	struct jml_differ {
+		jml_differ(cref<jml_view> old, cref<jml_view> now, ref<core::vector<jml_change>> changes)
+		: before(old)
+		, after(now)
+		, out(changes) {}
+
+		void emit(jml_change_type type, u64 hash, u32 node) {
+			if (!out.data) {
+				out = core::vector<jml_change>(0);
+			}
+
+			out.add(jml_change{ type, hash, node });
+		}
+
+		// every entry below a table that appeared or went away is reported on its own,
+		// so subscribers to a nested path still fire
+		void subtree(cref<jml_view> doc, u32 n, u64 scope, jml_change_type type) {
+			if (doc.type(n) != jml_type::tbl) return;
+			for (u32 c = doc.first(n); c < doc.end(n); c = doc.next(c)) {
+				u64 hash = jml_hash_child(scope, doc.key(c));
+				subtree(doc, c, hash, type);
+				emit(type, hash, type == jml_change_type::removed ? JML_NONE : c);
+			}
+		}
+
+		// o and n are the same table in both documents, true if anything below it changed
+		bool table(u32 o, u32 n, u64 scope) {
+			bool dirty = false;
+			for (u32 c = after.first(n); c < after.end(n); c = after.next(c)) {
+				core::stringview name = after.key(c);
+				u64 hash = jml_hash_child(scope, name);
+				u32 oc = before.lookup(hash, name);
+				if (oc == JML_NONE) {
+					subtree(after, c, hash, jml_change_type::added);
+					emit(jml_change_type::added, hash, c);
+					dirty = true;
+					continue;
+				}
+
+				bool nested = after.type(c) == jml_type::tbl && before.type(oc) == jml_type::tbl;
+				if (nested) {
+					if (!table(oc, c, hash)) continue;
+				} else {
+					if (jml_equal(before, oc, after, c)) continue;
+
+					// a table replaced by a value, or the other way around
+					subtree(before, oc, hash, jml_change_type::removed);
+					subtree(after, c, hash, jml_change_type::added);
+				}
+
+				emit(jml_change_type::changed, hash, c);
+				dirty = true;
+			}
+
+			for (u32 c = before.first(o); c < before.end(o); c = before.next(c)) {
+				core::stringview name = before.key(c);
+				u64 hash = jml_hash_child(scope, name);
+				if (after.lookup(hash, name) != JML_NONE) continue;
+
+				subtree(before, c, hash, jml_change_type::removed);
+				emit(jml_change_type::removed, hash, JML_NONE);
+				dirty = true;
+			}
+
+			return dirty;
+		}
+
+		cref<jml_view> before;
+		cref<jml_view> after;
+		ref<core::vector<jml_change>> out;
+	};
+
+	void jml_diff(cref<jml_view> before, cref<jml_view> after, ref<core::vector<jml_change>> out) {
+		jml_differ differ(before, after, out);
+		if (!before.node_count && !after.node_count) return;
+
+		if (!before.node_count) {
+			differ.subtree(after, 0, JML_HASH_SEED, jml_change_type::added);
+			return;
+		}
+
+		if (!after.node_count) {
+			differ.subtree(before, 0, JML_HASH_SEED, jml_change_type::removed);
+			return;
+		}
+
+		differ.table(0, 0, JML_HASH_SEED);
+	}
+}
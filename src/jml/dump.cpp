@@ -7,72 +7,237 @@ import core.format;
 
 namespace jolly {
 	using doc_hierarchy = core::table<jml_tbl, core::vector<cptr<jml_tbl>>>;
-	template<typename T>
-	u64 min_space_required() = delete;
 
-	template<>
-	u64 min_space_required<bool>() {
-		return sizeof("false") - 1;
-	}
+	constexpr f64 JML_MAX_INTEGER = 9007199254740992.0; // 2^53, every integer below is exact
 
-	template<>
-	u64 min_space_required<f64>() {
-		constexpr u64 sign = 1;
-		constexpr u64 mantissa = 20;
-		constexpr u64 dot = 1;
-		constexpr u64 exp = 3 + 1; // 'e' + 3 digits
-		return sign + mantissa + dot + exp;
-	}
+	// writes straight into the file's buffer, it is only flushed when a write does not fit
+	// the output always parses back to the same document
+	struct jml_writer {
+		jml_writer(ref<core::file> out, jml_style s)
+		: f(out)
+		, style(s)
+		, depth(0) {}
 
-	template<typename T>
-	void format_safe(cref<T> arg, ref<core::file> f) {
-		if (f.data.rem() < min_space_required<T>()) {
-			f.write();
+		bool pretty() const {
+			return style == jml_style::pretty;
 		}
 
-		core::format(arg, f.data);
-	}
+		void reserve(u32 bytes) {
+			if (f.data.rem() < bytes) f.write();
+		}
+
+		void put(char c) {
+			reserve(1);
+			f.data.data[f.data.index++] = (u8)c;
+		}
+
+		void put(core::stringview str) {
+			f.write(core::membuf{ (ptr<u8>)str.data, str.size });
+		}
 
-	void dump_item(cref<jml_val> val, cref<jml_doc> data, cref<doc_hierarchy> hierarchy, ref<core::file> f) {
-		switch(val.type) {
-			case jml_type::boolean: {
-				format_safe(val.raw<bool>(), f);
-				break;
+		void indent() {
+			if (!pretty()) return;
+			for (u32 i : core::range(depth)) {
+				put('\t');
 			}
-			case jml_type::num: {
-				format_safe(val.raw<f64>(), f);
-				break;
+		}
+
+		// integers skip ryu, it is only used for values with a fraction
+		void number(f64 v) {
+			reserve(core::BLOCK_64);
+			if (v > -JML_MAX_INTEGER && v < JML_MAX_INTEGER && (f64)(i64)v == v) {
+				i64 whole = (i64)v;
+				u64 mag = whole < 0 ? (u64)-whole : (u64)whole;
+
+				u8 digits[20];
+				u32 count = 0;
+				do {
+					digits[count++] = (u8)('0' + mag % 10);
+					mag /= 10;
+				} while (mag);
+
+				if (whole < 0) f.data.data[f.data.index++] = '-';
+				while (count) f.data.data[f.data.index++] = digits[--count];
+				return;
+			}
+
+			core::format(v, f.data);
+		}
+
+		void boolean(bool v) {
+			put(v ? core::stringview("true") : core::stringview("false"));
+		}
+
+		// runs without escapes are copied in one piece
+		void string(core::stringview str) {
+			put('"');
+			u32 run = 0;
+			for (u32 i : core::range(str.size)) {
+				char c = str.data[i];
+				char esc = c == '"' ? '"' : c == '\\' ? '\\' : c == '\n' ? 'n' : c == '\t' ? 't' : 0;
+				if (!esc) continue;
+
+				put(core::stringview(str.data + run, i - run));
+				put('\\');
+				put(esc);
+				run = i + 1;
+			}
+
+			put(core::stringview(str.data + run, str.size - run));
+			put('"');
+		}
+
+		void key(core::stringview name) {
+			indent();
+			put(name);
+			put(pretty() ? core::stringview(" = ") : core::stringview("="));
+		}
+
+		// called before every entry or element but the first
+		void separate(bool element) {
+			if (element) {
+				put(pretty() ? core::stringview(", ") : core::stringview(","));
+			} else if (!pretty()) {
+				put(',');
+			}
+		}
+
+		// called after every entry
+		void finish() {
+			if (pretty()) put('\n');
+		}
+
+		void open(char c, bool table) {
+			put(c);
+			if (!table) {
+				if (pretty()) put(' ');
+				return;
 			}
-			case jml_type::str: {
-				f.write('"');
-				f.write(val.raw<core::string>());
-				f.write('"');
-				break;
+
+			depth++;
+			finish();
+		}
+
+		void close(char c, bool table) {
+			if (!table) {
+				if (pretty()) put(' ');
+				put(c);
+				return;
 			}
-			case jml_type::arr: {
-				f.write('[');
-				for (auto& child : val) {
-					dump_item(child, data, hierarchy, f);
-					f.write(',');
+
+			depth--;
+			indent();
+			put(c);
+		}
+
+		void value(cref<jml_view> src, u32 n) {
+			switch (src.type(n)) {
+				case jml_type::num: {
+					number(src.num(n));
+					break;
+				}
+				case jml_type::boolean: {
+					boolean(src.boolean(n));
+					break;
 				}
-				f.write(']');
-				break;
+				case jml_type::str: {
+					string(src.str(n));
+					break;
+				}
+				case jml_type::arr: {
+					open('[', false);
+					for (u32 c = src.first(n); c < src.end(n); c = src.next(c)) {
+						if (c != src.first(n)) separate(true);
+						value(src, c);
+					}
+
+					close(']', false);
+					break;
+				}
+				case jml_type::tbl: {
+					open('{', true);
+					entries(src, n);
+					close('}', true);
+					break;
+				}
+				default: break;
+			}
+		}
+
+		void entries(cref<jml_view> src, u32 n) {
+			for (u32 c = src.first(n); c < src.end(n); c = src.next(c)) {
+				if (c != src.first(n)) separate(false);
+				key(src.key(c));
+				value(src, c);
+				finish();
 			}
-			case jml_type::tbl: {
-				f.write('{');
-				for (auto child : hierarchy[val.raw<jml_tbl>()]) {
-					f.write(child->name);
-					f.write('=');
-					dump_item(data.get(*child), data, hierarchy, f);
-					f.write(',');
+		}
+
+		void value(cref<jml_val> val, cref<jml_doc> data, cref<doc_hierarchy> hierarchy) {
+			switch (val.type) {
+				case jml_type::num: {
+					number(val.raw<f64>());
+					break;
+				}
+				case jml_type::boolean: {
+					boolean(val.raw<bool>());
+					break;
+				}
+				case jml_type::str: {
+					string(val.raw<core::string>());
+					break;
+				}
+				case jml_type::arr: {
+					open('[', false);
+					bool first = true;
+					for (auto& child : val) {
+						if (!first) separate(true);
+						first = false;
+						value(child, data, hierarchy);
+					}
+
+					close(']', false);
+					break;
+				}
+				case jml_type::tbl: {
+					open('{', true);
+					auto& key = val.raw<jml_tbl>();
+					if (hierarchy.has(key)) {
+						entries(hierarchy.get(key), data, hierarchy);
+					}
+
+					close('}', true);
+					break;
 				}
-				f.write('}');
-				break;
+				default: break;
+			}
+		}
+
+		void entries(cref<core::vector<cptr<jml_tbl>>> children, cref<jml_doc> data, cref<doc_hierarchy> hierarchy) {
+			bool first = true;
+			for (auto child : children) {
+				if (!first) separate(false);
+				first = false;
+				key(child->name);
+				value(data.get(*child), data, hierarchy);
+				finish();
 			}
 		}
+
+		ref<core::file> f;
+		jml_style style;
+		u32 depth;
+	};
+
+	void jml_write(cref<jml_view> src, ref<core::file> f, jml_style style) {
+		if (!src.node_count) return;
+		jml_writer out(f, style);
+		out.entries(src, 0);
+		if (!out.pretty()) out.put('\n');
 	}
 
-	void jml_dump(cref<jml_doc> data, ref<core::file> f) {
+	// built docs have no child lists, they are grouped by parent first
+	void jml_dump(cref<jml_doc> data, ref<core::file> f, jml_style style) {
 		doc_hierarchy hierarchy;
 		core::vector<cptr<jml_tbl>> root(0);
 		for (auto& key : data.data.keys()) {
@@ -89,11 +254,8 @@ namespace jolly {
 			v.add(&key);
 		}
 
-		for (auto key : root) {
-			f.write(key->name);
-			f.write('=');
-			dump_item(data.get(*key), data, hierarchy, f);
-			f.write('\n');
-		}
+		jml_writer out(f, style);
+		out.entries(root, data, hierarchy);
+		if (!out.pretty()) out.put('\n');
 	}
 }
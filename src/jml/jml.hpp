@@ -12,6 +12,7 @@ import core.table;
 import core.vector;
 import core.string;
 import core.file;
+import core.simd;
 
 export namespace jolly {
 	enum class jml_type {
@@ -75,8 +76,566 @@ export namespace jolly {
 		return jml_type::boolean;
 	}
 
+	constexpr u32 JML_NONE = U32_MAX;
+	constexpr u32 JML_MAX_DEPTH = core::BLOCK_64;
+	constexpr u64 JML_HASH_SEED = 0xcbf29ce484222325ull; // fnv1a 64, also the hash of the root
+	constexpr u64 JML_HASH_PRIME = 0x100000001b3ull;
+	constexpr u64 JML_HASH_GOLDEN = 0x9e3779b97f4a7c15ull;
+
+	// fnv1a 64 of a single key, constexpr so bindings can hash their field names at compile time
+	constexpr u64 jml_hash_key(cptr<char> data, u32 size) {
+		u64 h = JML_HASH_SEED;
+		for (u32 i = 0; i < size; i++) {
+			h = (h ^ (u8)data[i]) * JML_HASH_PRIME;
+		}
+
+		return h;
+	}
+
+	u64 jml_hash_key(core::stringview name) {
+		return jml_hash_key(name.data, name.size);
+	}
+
+	// path hashes fold the key hash of every segment into the hash of the parent path, so the
+	// key half can be computed ahead of time and "a.b" continues the hash of "a"
+	constexpr u64 jml_hash_combine(u64 parent, u64 key) {
+		return parent ^ (key + JML_HASH_GOLDEN + (parent << 6) + (parent >> 2));
+	}
+
+	u64 jml_hash_child(u64 parent, core::stringview name) {
+		return jml_hash_combine(parent, jml_hash_key(name));
+	}
+
+	// fnv1a 32 step used by jml_doc's table, a key continues the hash of its parent
+	constexpr u32 JML_TBL_SEED = 0x811c9dc5;
+
+	u32 jml_tbl_fold(u32 h, i8 c) {
+		return (h ^ c) * 0x01000193;
+	}
+
+	// a dotted path like "a.b.c" hashed once for both jml_doc and tape lookups, both hashes
+	// are built segment by segment in the same pass
+	// the text is not copied and has to outlive the handle, depth is 0 for malformed paths
+	struct jml_path {
+		jml_path()
+		: path()
+		, name()
+		, hash(0)
+		, doc_hash(0)
+		, depth(0) {}
+
+		jml_path(core::stringview str)
+		: path(str)
+		, name()
+		, hash(JML_HASH_SEED)
+		, doc_hash(JML_TBL_SEED)
+		, depth(0) {
+			u32 beg = 0;
+			u64 key = JML_HASH_SEED;
+			for (u32 i = 0; i <= str.size; i++) {
+				if (i < str.size && str.data[i] != '.') {
+					key = (key ^ (u8)str.data[i]) * JML_HASH_PRIME;
+					doc_hash = jml_tbl_fold(doc_hash, str.data[i]);
+					continue;
+				}
+
+				if (i == beg || depth >= JML_MAX_DEPTH) {
+					depth = 0;
+					return;
+				}
+
+				hash = jml_hash_combine(hash, key);
+				key = JML_HASH_SEED;
+				name = core::stringview(str.data + beg, i - beg);
+				beg = i + 1;
+				depth++;
+			}
+		}
+
+		core::stringview path;
+		core::stringview name; // last segment
+		u64 hash; // tape path hash
+		u32 doc_hash; // jml_doc table hash
+		u32 depth; // segments
+	};
+
+	constexpr u32 JML_POOLED = 1u << 31; // set in a string's size when its body was unescaped into the pool
+
+	struct jml_span {
+		u32 offset;
+		u32 size;
+	};
+
+	struct jml_children {
+		u32 end; // node past the subtree
+		u32 count; // direct children
+	};
+
+	// containers are followed by their subtree in preorder, array elements have no key
+	struct jml_node {
+		u16 type;
+		u16 key_size;
+		u32 key; // offset into the source text
+		union {
+			f64 num;
+			bool boolean;
+			jml_span str;
+			jml_children children;
+		};
+	};
+
+	static_assert(sizeof(jml_node) == 16);
+
+	enum class jml_opcode : u32 {
+		push = 0,
+		load,
+		neg,
+		add,
+		sub,
+		mul,
+		div,
+	};
+
+	struct jml_op {
+		jml_opcode code;
+		u32 node; // load only
+		f64 value; // push only
+	};
+
+	f64 jml_apply(jml_opcode code, f64 a, f64 b) {
+		switch (code) {
+			case jml_opcode::add: return a + b;
+			case jml_opcode::sub: return a - b;
+			case jml_opcode::mul: return a * b;
+			case jml_opcode::div: return a / b;
+			default: return 0;
+		}
+	}
+
+	struct jml_expr {
+		u32 node; // receives the result
+		u32 begin; // code range
+		u32 end;
+	};
+
+	struct jml_dep {
+		u32 input; // node read by a load
+		u32 expr;
+	};
+
+	// expressions are compiled to stack code at parse time with constant subexpressions folded
+	// expressions only read keys defined before them, so exprs is already in dependency order
+	// and a change is propagated with one forward sweep over the dependents it reaches
+	struct jml_program {
+		static constexpr u32 MAX_STACK = core::BLOCK_64;
+
+		jml_program()
+		: code{}
+		, exprs{}
+		, deps{}
+		, dirty{} {}
+
+		void clear() {
+			code.size = 0;
+			exprs.size = 0;
+			deps.size = 0;
+		}
+
+		void emit(cref<jml_op> op) {
+			if (!code.data) {
+				code = core::vector<jml_op>(0);
+			}
+
+			code.add(op);
+		}
+
+		// registers the code from begin to the end of code as the expression computing node
+		void add(ref<core::vector<jml_node>> nodes, u32 node, u32 begin) {
+			if (!exprs.data) {
+				exprs = core::vector<jml_expr>(0);
+				deps = core::vector<jml_dep>(0);
+			}
+
+			u32 e = exprs.size;
+			exprs.add(jml_expr{ node, begin, code.size });
+			for (u32 i : core::range(begin, code.size)) {
+				if (code[i].code == jml_opcode::load) deps.add(jml_dep{ code[i].node, e });
+			}
+
+			nodes[node].num = eval(nodes, e);
+		}
+
+		// deps are recorded in expression order, lookups need them grouped by input
+		void finish() {
+			if (deps.size < 2) return;
+			core::vector<jml_dep> scratch(deps.size);
+			core::merge_sort(deps.data, scratch.data, deps.size, [](cref<jml_dep> a, cref<jml_dep> b) {
+				return a.input < b.input;
+			});
+		}
+
+		f64 eval(cref<core::vector<jml_node>> nodes, u32 e) const {
+			f64 stack[MAX_STACK];
+			u32 top = 0;
+
+			auto& expr = exprs[e];
+			for (u32 i : core::range(expr.begin, expr.end)) {
+				auto& op = code[i];
+				switch (op.code) {
+					case jml_opcode::push: {
+						stack[top++] = op.value;
+						break;
+					}
+					case jml_opcode::load: {
+						stack[top++] = nodes[op.node].num;
+						break;
+					}
+					case jml_opcode::neg: {
+						stack[top - 1] = -stack[top - 1];
+						break;
+					}
+					default: {
+						top--;
+						stack[top - 1] = jml_apply(op.code, stack[top - 1], stack[top]);
+						break;
+					}
+				}
+			}
+
+			return stack[0];
+		}
+
+		// first dep reading input
+		u32 _lower(u32 input) const {
+			u32 lo = 0;
+			u32 hi = deps.size;
+			while (lo < hi) {
+				u32 mid = (lo + hi) / 2;
+				if (deps[mid].input < input) lo = mid + 1;
+				else hi = mid;
+			}
+
+			return lo;
+		}
+
+		void _mark(u32 input, ref<u32> lowest) {
+			for (u32 i = _lower(input); i < deps.size && deps[i].input == input; i++) {
+				u32 e = deps[i].expr;
+				dirty[e / core::BLOCK_64] |= (u64)1 << (e % core::BLOCK_64);
+				lowest = core::min(lowest, e);
+			}
+		}
+
+		// reevaluates everything downstream of input, returns how many expressions ran
+		u32 update(ref<core::vector<jml_node>> nodes, u32 input) {
+			if (!exprs.size) return 0;
+
+			u32 words = exprs.size / core::BLOCK_64 + 1;
+			if (dirty.reserve < words) {
+				dirty.resize(words);
+			}
+
+			dirty.size = words;
+			u32 lowest = U32_MAX;
+			_mark(input, lowest);
+			if (lowest == U32_MAX) return 0;
+
+			u32 count = 0;
+			for (u32 w = lowest / core::BLOCK_64; w < words; w++) {
+				// bits set while the word is processed are always higher, dependents come later
+				while (dirty[w]) {
+					u32 e = w * core::BLOCK_64 + core::tzcnt64(dirty[w]);
+					dirty[w] &= dirty[w] - 1;
+
+					u32 node = exprs[e].node;
+					f64 value = eval(nodes, e);
+					count++;
+					if (value == nodes[node].num) continue;
+
+					nodes[node].num = value;
+					_mark(node, lowest);
+				}
+			}
+
+			return count;
+		}
+
+		core::vector<jml_op> code;
+		core::vector<jml_expr> exprs;
+		core::vector<jml_dep> deps; // sorted by input once parsing is done
+		core::vector<u64> dirty; // one bit per expression, only used during update
+	};
+
+	struct jml_slot {
+		u64 hash;
+		u32 node; // 0 marks an empty slot, the root is never indexed
+	};
+
+	// read access to a flat document, nothing here owns memory so the same accessors serve
+	// tapes built in memory and binary images mapped from disk
+	// node 0 is the root table, lookups probe the index with a precomputed path hash and
+	// confirm the hit by its key
+	// keys and strings are spans of string_data, strings that needed unescaping live in
+	// pool_data instead, images keep both in one section
+	struct jml_view {
+		jml_view()
+		: node_data(nullptr)
+		, string_data(nullptr)
+		, pool_data(nullptr)
+		, slot_data(nullptr)
+		, node_count(0)
+		, slot_count(0) {}
+
+		// JML_NONE on a miss, name is the last path segment
+		u32 lookup(u64 hash, core::stringview name) const {
+			if (!slot_count) return JML_NONE;
+			u32 mask = slot_count - 1;
+			for (u32 i = (u32)hash & mask;; i = (i + 1) & mask) {
+				auto& slot = slot_data[i];
+				if (!slot.node) return JML_NONE;
+				if (slot.hash == hash && key(slot.node) == name) return slot.node;
+			}
+		}
+
+		jml_type type(u32 n) const {
+			return (jml_type)node_data[n].type;
+		}
+
+		core::stringview key(u32 n) const {
+			return core::stringview(string_data + node_data[n].key, node_data[n].key_size);
+		}
+
+		f64 num(u32 n) const {
+			JOLLY_ASSERT(type(n) == jml_type::num);
+			return node_data[n].num;
+		}
+
+		bool boolean(u32 n) const {
+			JOLLY_ASSERT(type(n) == jml_type::boolean);
+			return node_data[n].boolean;
+		}
+
+		core::stringview str(u32 n) const {
+			JOLLY_ASSERT(type(n) == jml_type::str);
+			auto& span = node_data[n].str;
+			cptr<char> base = span.size & JML_POOLED ? pool_data : string_data;
+			return core::stringview(base + span.offset, span.size & ~JML_POOLED);
+		}
+
+		bool container(u32 n) const {
+			return type(n) == jml_type::tbl || type(n) == jml_type::arr;
+		}
+
+		u32 size(u32 n) const {
+			JOLLY_ASSERT(container(n));
+			return node_data[n].children.count;
+		}
+
+		// children of n are first(n), next(first(n)), ... up to end(n)
+		u32 first(u32 n) const {
+			return n + 1;
+		}
+
+		u32 end(u32 n) const {
+			return container(n) ? node_data[n].children.end : n + 1;
+		}
+
+		u32 next(u32 n) const {
+			return end(n);
+		}
+
+		// JML_NONE on a miss
+		u32 find(cref<jml_path> path) const {
+			if (!path.depth) return JML_NONE;
+			return lookup(path.hash, path.name);
+		}
+
+		u32 find(core::stringview path) const {
+			return find(jml_path(path));
+		}
+
+		cptr<jml_node> node_data;
+		cptr<char> string_data;
+		cptr<char> pool_data;
+		cptr<jml_slot> slot_data; // open addressing, the count is a power of two
+		u32 node_count;
+		u32 slot_count;
+	};
+
+	// flat document built by the parser, keys and strings are spans of the source text, which
+	// the caller keeps alive, or of file when the tape was loaded from disk
+	// nodes, the escape pool and the path index are the only allocations, the view is
+	// repointed whenever one of them grows
+	struct jml_tape : jml_view {
+		static constexpr u32 MIN_INDEX = core::BLOCK_64;
+
+		jml_tape()
+		: jml_view()
+		, nodes{}
+		, pool{}
+		, index{}
+		, program()
+		, count(0)
+		, file() {}
+
+		// the view would keep pointing at the other tape's buffers
+		jml_tape(cref<jml_tape> other) = delete;
+		ref<jml_tape> operator=(cref<jml_tape> other) = delete;
+
+		// sizes are a guess from the source length, everything grows by doubling past that
+		void reserve(u32 expected_nodes) {
+			if (nodes.reserve < expected_nodes) nodes.resize(expected_nodes);
+
+			u32 slots = MIN_INDEX;
+			while (slots < expected_nodes * 2) slots *= 2;
+			if (index.size < slots) _rehash(slots);
+			_sync();
+		}
+
+		// source is the text the nodes added next point into
+		void clear(core::stringview source = core::stringview()) {
+			nodes.size = 0;
+			pool.size = 0;
+			for (auto& slot : index) {
+				slot = jml_slot{ 0, 0 };
+			}
+
+			program.clear();
+			count = 0;
+			string_data = source.data;
+			_sync();
+		}
+
+		// name is empty or a view of the source text
+		u32 add(jml_type t, core::stringview name) {
+			if (nodes.reserve <= nodes.size) {
+				nodes.resize(core::max<u32>(nodes.reserve * 2, core::BLOCK_64));
+			}
+
+			JOLLY_ASSERT(name.size <= U16_MAX, "jml keys are limited to 65535 bytes");
+			u32 n = nodes.size++;
+			jml_node& node = nodes[n];
+			node.type = (u16)t;
+			node.key_size = (u16)name.size;
+			node.key = name.size ? (u32)(name.data - string_data) : 0;
+			node.num = 0;
+			_sync();
+			return n;
+		}
+
+		// room for bytes at the end of the pool, returns its offset
+		u32 add_pooled(u32 bytes) {
+			u32 offset = pool.size;
+			if (pool.reserve < offset + bytes) {
+				pool.resize(core::max<u32>(pool.reserve * 2, offset + bytes));
+			}
+
+			pool.size += bytes;
+			_sync();
+			return offset;
+		}
+
+		// a later node with the same path replaces the earlier one
+		void insert(u64 hash, u32 n) {
+			if ((count + 1) * 2 > index.size) {
+				_rehash(core::max<u32>(index.size * 2, MIN_INDEX));
+			}
+
+			u32 mask = index.size - 1;
+			for (u32 i = (u32)hash & mask;; i = (i + 1) & mask) {
+				auto& slot = index[i];
+				if (!slot.node) {
+					slot = jml_slot{ hash, n };
+					count++;
+					return;
+				}
+
+				if (slot.hash == hash && key(slot.node) == key(n)) {
+					slot.node = n;
+					return;
+				}
+			}
+		}
+
+		void _rehash(u32 slots) {
+			core::vector<jml_slot> old = forward_data(index);
+			index = core::vector<jml_slot>(slots);
+			index.size = slots;
+
+			u32 mask = slots - 1;
+			for (auto& slot : old) {
+				if (!slot.node) continue;
+				u32 i = (u32)slot.hash & mask;
+				while (index[i].node) i = (i + 1) & mask;
+				index[i] = slot;
+			}
+
+			_sync();
+		}
+
+		void _sync() {
+			node_data = nodes.data;
+			pool_data = pool.data;
+			slot_data = index.data;
+			node_count = nodes.size;
+			slot_count = index.size;
+		}
+
+		// expressions reading n are reevaluated, returns how many ran
+		// setting an expression's own node is overwritten once one of its inputs changes
+		u32 set(u32 n, f64 value) {
+			JOLLY_ASSERT(type(n) == jml_type::num);
+			nodes[n].num = value;
+			return program.update(nodes, n);
+		}
+
+		core::vector<jml_node> nodes;
+		core::vector<char> pool; // unescaped string bodies
+		core::vector<jml_slot> index; // open addressing, the size is a power of two
+		jml_program program;
+		u32 count;
+		core::file_map file; // set by jml_load, the source text is the mapping
+	};
+
+	constexpr u32 JML_MAGIC = 0x424c4d4a; // "JMLB"
+	constexpr u32 JML_VERSION = 2; // 2 combines per key hashes into path hashes
+
+	// binary layout, the header is followed by the node array, the slot array and the string
+	// section, nodes and slots are copies of the tape they were saved from with keys and
+	// strings repointed into the section, which only holds the bytes they use
+	struct jml_header {
+		u32 magic;
+		u32 version;
+		u32 node_count;
+		u32 slot_count;
+		u32 string_bytes;
+		u32 nodes; // byte offsets from the start of the file
+		u32 slots;
+		u32 strings;
+	};
+
+	static_assert(sizeof(jml_header) % alignof(jml_node) == 0);
+
+	bool jml_binary(cptr<u8> data, u32 size) {
+		return size >= sizeof(jml_header) && ((cptr<jml_header>)data)->magic == JML_MAGIC;
+	}
+
+	// binary document used straight from a file mapping, opening checks the header and points
+	// the view into the mapping, pages are only read once a lookup touches them
+	// expressions are stored as their values, images are read only
+	struct jml_image : jml_view {
+		jml_image()
+		: jml_view()
+		, file() {}
+
+		core::file_map file;
+	};
+
 	struct jml_doc {
-		jml_doc() = default;
+		jml_doc()
+		: data()
+		, tape()
+		, image() {}
 
 		cref<jml_val> get(core::stringview key) const {
 			jml_tbl tmp{ key, nullptr, nullptr };
@@ -102,7 +661,13 @@ export namespace jolly {
 			return get(key);
 		}
 
+		// read only, nullptr on a miss
+		cptr<jml_val> find(cref<jml_path> path) const;
+		cptr<jml_val> find(core::stringview path) const;
+
 		core::table<jml_tbl, jml_val> data;
+		jml_tape tape; // set when loaded from text, keys point into its source
+		jml_image image; // set when loaded from a binary file, keys point into the mapping
 	};
 
 	struct jml_val {
@@ -204,6 +769,27 @@ export namespace jolly {
 		return res;
 	}
 
+	// the key chain lives on the stack, the table is probed once with the precomputed hash
+	cptr<jml_val> jml_doc::find(cref<jml_path> path) const {
+		if (!path.depth) return nullptr;
+
+		jml_tbl chain[JML_MAX_DEPTH];
+		u32 depth = 0;
+		u32 beg = 0;
+		for (u32 i = 0; i <= path.path.size; i++) {
+			if (i < path.path.size && path.path.data[i] != '.') continue;
+			cptr<jml_tbl> parent = depth ? &chain[depth - 1] : nullptr;
+			chain[depth++] = jml_tbl{ core::stringview(path.path.data + beg, i - beg), parent, nullptr };
+			beg = i + 1;
+		}
+
+		return data.find(chain[depth - 1], path.doc_hash);
+	}
+
+	cptr<jml_val> jml_doc::find(core::stringview path) const {
+		return find(jml_path(path));
+	}
+
 	template<typename T>
 	core::vector<jml_val> jml_vector_impl(std::initializer_list<T> args) {
 		core::vector<jml_val> res(0);
@@ -222,7 +808,126 @@ export namespace jolly {
 		return jml_vector_impl<f64>(args);
 	}
 
-	void jml_dump(cref<jml_doc> data, ref<core::file> f);
+	enum class jml_style {
+		compact = 0, // one line, entries separated by commas
+		pretty, // one entry per line, tables indented with tabs
+	};
+
+	// tapes and images are written in node order without any extra allocation
+	void jml_write(cref<jml_view> src, ref<core::file> f, jml_style style = jml_style::pretty);
+	void jml_dump(cref<jml_doc> data, ref<core::file> f, jml_style style = jml_style::pretty);
+
+	// stage 1 of the parser, one bit per source byte
+	struct jml_index {
+		jml_index()
+		: structural{}
+		, space{}
+		, backslash{} {}
+
+		core::vector<u64> structural; // = , { } [ ] quotes and newlines outside strings and comments
+		core::vector<u64> space; // spaces, tabs and carriage returns outside strings
+		core::vector<u64> backslash; // backslashes inside strings
+	};
+
+	void jml_scan(ref<jml_index> index, cptr<u8> data, u32 size);
+
+	enum class jml_error {
+		none = 0,
+		syntax,
+		unterminated_string,
+		unknown_key,
+		not_a_number,
+		too_deep,
+		io,
+		bad_image,
+		too_long,
+	};
+
+	struct jml_result {
+		jml_error error;
+		u32 line; // where parsing stopped, 1 based
+	};
+
+	bool jml_ident(char c) {
+		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+	}
+
+	bool jml_digit(char c) {
+		return c >= '0' && c <= '9';
+	}
+
+	// unsigned decimal with optional fraction and exponent, cur is left after the number
+	bool jml_number(ref<cptr<char>> cur, cptr<char> end, ref<f64> out);
+
+	// nothing is copied out of text, it has to outlive the tape, only strings with escapes
+	// are unescaped into the tape's pool, jml_load keeps the file mapped in the tape
+	jml_result jml_parse(ref<jml_tape> tape, core::stringview text);
+	jml_result jml_load(ref<jml_tape> tape, core::stringview path);
+
+	// the mapping moves into the image, which is left empty on failure
+	jml_result jml_open(ref<jml_image> image, fwd<core::file_map> file);
+	jml_result jml_open(ref<jml_image> image, core::stringview path);
+	jml_result jml_save(cref<jml_tape> tape, core::stringview path);
+	jml_result jml_convert(core::stringview src, core::stringview dst); // text to binary
+
+	enum class jml_action {
+		next = 0,
+		skip, // from key skips the value, from a begin skips the contents and the matching end
+		stop, // ends the stream without an error
+	};
+
+	// expressions cannot be evaluated without keeping the document, they are passed through
+	// with type unk and their source text in str
+	struct jml_scalar {
+		jml_type type;
+		f64 num;
+		bool boolean;
+		core::stringview str; // points into the read buffer, only valid during the callback
+	};
+
+	typedef jml_action (*pfn_jml_key)(ptr<void> user, core::stringview name);
+	typedef jml_action (*pfn_jml_begin)(ptr<void> user);
+	typedef void (*pfn_jml_end)(ptr<void> user);
+	typedef jml_action (*pfn_jml_value)(ptr<void> user, cref<jml_scalar> value);
+
+	// every callback is optional, a missing one acts as if it returned next
+	// array elements get a value or begin_array without a key
+	struct jml_handler {
+		ptr<void> user;
+		pfn_jml_key key;
+		pfn_jml_begin begin_table;
+		pfn_jml_end end_table;
+		pfn_jml_begin begin_array;
+		pfn_jml_end end_array;
+		pfn_jml_value value;
+	};
+
+	// event driven reading through one read buffer, memory use does not depend on the file
+	// a single key, string or scalar has to fit the buffer, skipped values do not
+	jml_result jml_stream(ref<core::file_base> f, cref<jml_handler> handler);
+	jml_result jml_stream(core::stringview path, cref<jml_handler> handler);
+
+	enum class jml_change_type {
+		added = 0,
+		changed,
+		removed,
+	};
+
+	struct jml_change {
+		jml_change_type type;
+		u64 hash; // path hash
+		u32 node; // in the newer document, JML_NONE when removed
+	};
+
+	// keyed entries that differ between two versions of a document, arrays compare as a whole
+	// a table is reported after its entries, as changed whenever anything below it changed,
+	// entries of added and removed tables are reported as added and removed too
+	void jml_diff(cref<jml_view> before, cref<jml_view> after, ref<core::vector<jml_change>> out);
+
+	// doc must be empty, it is filled from a tape or image it keeps, keys point into src
+	void jml_build(ref<jml_doc> doc, cref<jml_view> src);
+	jml_result jml_parse(ref<jml_doc> doc, core::stringview text); // text has to outlive doc
+	jml_result jml_load(ref<jml_doc> doc, core::stringview path); // text or binary
 }
 
 export namespace core {
@@ -232,13 +937,13 @@ export namespace core {
 
 		// based on fnv1a
 		static u32 hash(cref<type> key) {
-			u32 h = 0x811c9dc5;
+			u32 h = jolly::JML_TBL_SEED;
 			if (key.parent) {
 				h = hash(*key.parent);
 			}
 
 			for (i32 i : range(key.name.size))
-				h = (h ^ key.name[i]) * 0x01000193;
+				h = jolly::jml_tbl_fold(h, key.name[i]);
 
 			return h;
 		}
@@ -0,0 +1,568 @@
+module;
+
+#include <core/core.h>
+
+module jolly.jml;
+import core.format;
+
+namespace jolly {
+	// powers of ten that are exact in a double
+	constexpr f64 JML_POW10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+	};
+
+	constexpr u64 JML_EXACT_MANTISSA = (u64)1 << 53;
+	constexpr u32 JML_MAX_NUMBER = core::BLOCK_64;
+
+	// first set bit at or after p, limit if there is none
+	u32 jml_next(cref<core::vector<u64>> bits, u32 p, u32 limit) {
+		u32 w = p / core::BLOCK_64;
+		u64 word = bits[w] & (~0ull << (p % core::BLOCK_64));
+		while (!word) {
+			if (++w >= bits.size) return limit;
+			word = bits[w];
+		}
+
+		return core::min(w * core::BLOCK_64 + core::tzcnt64(word), limit);
+	}
+
+	// first clear bit at or after p, bits past the end of the source are clear
+	u32 jml_next_clear(cref<core::vector<u64>> bits, u32 p, u32 limit) {
+		u32 w = p / core::BLOCK_64;
+		u64 word = ~bits[w] & (~0ull << (p % core::BLOCK_64));
+		while (!word) {
+			if (++w >= bits.size) return limit;
+			word = ~bits[w];
+		}
+
+		return core::min(w * core::BLOCK_64 + core::tzcnt64(word), limit);
+	}
+
+	bool jml_any(cref<core::vector<u64>> bits, u32 beg, u32 end) {
+		return jml_next(bits, beg, end) < end;
+	}
+
+	bool jml_number(ref<cptr<char>> cur, cptr<char> end, ref<f64> out) {
+		cptr<char> beg = cur;
+		u64 mantissa = 0;
+		u32 digits = 0;
+		i32 exp = 0;
+
+		for (; cur < end && jml_digit(*cur); cur++, digits++) {
+			mantissa = mantissa * 10 + (*cur - '0');
+		}
+
+		if (cur < end && *cur == '.') {
+			for (cur++; cur < end && jml_digit(*cur); cur++, digits++, exp--) {
+				mantissa = mantissa * 10 + (*cur - '0');
+			}
+		}
+
+		if (!digits) return false;
+
+		if (cur < end && (*cur == 'e' || *cur == 'E')) {
+			cur++;
+			bool neg = cur < end && *cur == '-';
+			if (neg || (cur < end && *cur == '+')) cur++;
+			if (cur >= end || !jml_digit(*cur)) return false;
+
+			i32 e = 0;
+			for (; cur < end && jml_digit(*cur); cur++) {
+				e = core::min(e * 10 + (*cur - '0'), 9999);
+			}
+
+			exp += neg ? -e : e;
+		}
+
+		// exact when the mantissa and the power of ten both fit a double
+		if (digits <= 19 && mantissa <= JML_EXACT_MANTISSA && exp >= -22 && exp <= 22) {
+			f64 m = (f64)mantissa;
+			out = exp < 0 ? m / JML_POW10[-exp] : m * JML_POW10[exp];
+			return true;
+		}
+
+		u32 size = (u32)(cur - beg);
+		if (size >= JML_MAX_NUMBER) return false;
+
+		char buf[JML_MAX_NUMBER];
+		core::copy8((ptr<u8>)beg, (ptr<u8>)buf, size);
+		buf[size] = 0;
+		out = core::stod(buf);
+		return true;
+	}
+
+	// stage 2, recursive descent guided by the stage 1 index: whitespace runs, comments and
+	// string bodies are skipped by jumping through bitmaps instead of looking at every byte
+	// nodes are appended to the tape in preorder and expressions are evaluated as soon as
+	// they are read, names are looked up through the tape's path index
+	struct jml_parser {
+		jml_parser(ref<jml_tape> out, cref<jml_index> idx, cptr<char> beg, cptr<char> last)
+		: tape(out)
+		, index(idx)
+		, base(beg)
+		, cur(beg)
+		, end(last)
+		, size((u32)(last - beg))
+		, line(1)
+		, error(jml_error::none)
+		, scopes{ JML_HASH_SEED }
+		, depth(0)
+		, stack(0) {}
+
+		u32 pos() const {
+			return (u32)(cur - base);
+		}
+
+		bool fail(jml_error err) {
+			if (error == jml_error::none) error = err;
+			return false;
+		}
+
+		char peek() const {
+			return cur < end ? *cur : 0;
+		}
+
+		// newlines separate entries, they are left for the caller
+		// comment bodies are not structural, the next structural after a hash is its newline
+		void skip_space() {
+			cur = base + jml_next_clear(index.space, pos(), size);
+			if (cur < end && *cur == '#') {
+				cur = base + jml_next(index.structural, pos(), size);
+			}
+		}
+
+		void skip_lines() {
+			for (;;) {
+				skip_space();
+				if (cur >= end || *cur != '\n') return;
+				cur++;
+				line++;
+			}
+		}
+
+		bool ident(ref<core::stringview> out) {
+			cptr<char> beg = cur;
+			while (cur < end && jml_ident(*cur)) cur++;
+			if (cur == beg) return fail(jml_error::syntax);
+
+			out = core::stringview(beg, (u32)(cur - beg));
+			return true;
+		}
+
+		bool keyword(core::stringview word) {
+			u32 rem = (u32)(end - cur);
+			if (rem < word.size) return false;
+			if (!(core::stringview(cur, word.size) == word)) return false;
+			if (rem > word.size && jml_ident(cur[word.size])) return false;
+
+			cur += word.size;
+			return true;
+		}
+
+		// entries up to close, close is 0 for the document itself
+		bool entries(u32 table, char close) {
+			for (;;) {
+				skip_lines();
+				if (cur >= end) return close ? fail(jml_error::syntax) : true;
+				if (*cur == close) {
+					cur++;
+					return true;
+				}
+
+				core::stringview name;
+				if (!ident(name)) return false;
+				if (name.size > U16_MAX) return fail(jml_error::too_long); // nodes store a u16 key size
+
+				skip_space();
+				if (peek() != '=') return fail(jml_error::syntax);
+				cur++;
+
+				// indexed once complete, so an entry cannot refer to itself
+				u32 n = tape.nodes.size;
+				if (!value(name)) return false;
+				tape.nodes[table].children.count++;
+				tape.insert(jml_hash_child(scopes[depth], name), n);
+
+				skip_space();
+				char c = peek();
+				if (c == ',') {
+					cur++;
+				} else if (c != '\n' && c != close) {
+					return fail(jml_error::syntax);
+				}
+			}
+		}
+
+		bool value(core::stringview name) {
+			skip_space();
+			if (peek() != '{') return scalar(name);
+			if (depth + 1 >= JML_MAX_DEPTH) return fail(jml_error::too_deep);
+			cur++;
+
+			u32 n = tape.add(jml_type::tbl, name);
+			scopes[depth + 1] = jml_hash_child(scopes[depth], name);
+			depth++;
+			bool res = entries(n, '}');
+			depth--;
+
+			tape.nodes[n].children.end = tape.nodes.size;
+			return res;
+		}
+
+		// anything but a table, array elements have an empty name
+		bool scalar(core::stringview name) {
+			char c = peek();
+			if (c == '[') {
+				cur++;
+				return array(name);
+			}
+
+			if (c == '"') {
+				cur++;
+				return string(name);
+			}
+
+			bool truth = keyword("true");
+			if (truth || keyword("false")) {
+				u32 n = tape.add(jml_type::boolean, name);
+				tape.nodes[n].boolean = truth;
+				return true;
+			}
+
+			// a fully folded expression is stored as a plain number
+			u32 begin = tape.program.code.size;
+			bool constant = false;
+			stack = 0;
+			if (!expr(constant)) return false;
+
+			u32 n = tape.add(jml_type::num, name);
+			if (constant) {
+				tape.nodes[n].num = tape.program.code[begin].value;
+				tape.program.code.size = begin;
+			} else {
+				tape.program.add(tape.nodes, n, begin);
+			}
+
+			return true;
+		}
+
+		bool array(core::stringview name) {
+			u32 n = tape.add(jml_type::arr, name);
+			for (;;) {
+				skip_lines();
+				if (peek() == ']') {
+					cur++;
+					break;
+				}
+
+				if (peek() == '{') return fail(jml_error::syntax);
+				if (!scalar(core::stringview())) return false;
+				tape.nodes[n].children.count++;
+
+				skip_lines();
+				char c = peek();
+				if (c == ',') {
+					cur++;
+				} else if (c != ']') {
+					return fail(jml_error::syntax);
+				}
+			}
+
+			tape.nodes[n].children.end = tape.nodes.size;
+			return true;
+		}
+
+		// supports \" \\ \n and \t, bodies without escapes stay in the source, the rest are
+		// unescaped into the tape's pool
+		// string bodies are not structural so the closing quote is the next structural
+		// newlines inside strings are not counted towards line
+		bool string(core::stringview name) {
+			u32 beg = pos();
+			u32 close = jml_next(index.structural, beg, size);
+			if (close >= size || base[close] != '"') return fail(jml_error::unterminated_string);
+			if (close - beg >= JML_POOLED) return fail(jml_error::too_long);
+
+			core::stringview raw(base + beg, close - beg);
+			cur = base + close + 1;
+
+			u32 n = tape.add(jml_type::str, name);
+			if (!jml_any(index.backslash, beg, close)) {
+				tape.nodes[n].str = jml_span{ beg, raw.size };
+				return true;
+			}
+
+			// unescaping only shrinks, reserve the raw size and write in place
+			u32 offset = tape.add_pooled(raw.size);
+			ptr<char> dst = &tape.pool[offset];
+			u32 count = 0;
+			for (u32 i = 0; i < raw.size; i++) {
+				char ch = raw.data[i];
+				if (ch == '\\' && i + 1 < raw.size) {
+					ch = raw.data[++i];
+					ch = ch == 'n' ? '\n' : ch == 't' ? '\t' : ch;
+				}
+
+				dst[count++] = ch;
+			}
+
+			tape.pool.size = offset + count;
+			tape.nodes[n].str = jml_span{ offset, count | JML_POOLED };
+			return true;
+		}
+
+		// expressions compile to stack code, constant is true when the code so far is a single
+		// push, two constant operands are folded into one push as soon as they meet
+		// expr := term (('+' | '-') term)*
+		bool expr(ref<bool> constant) {
+			if (!term(constant)) return false;
+			for (;;) {
+				skip_space();
+				char c = peek();
+				if (c != '+' && c != '-') return true;
+				cur++;
+
+				bool rhs = false;
+				if (!term(rhs)) return false;
+				binary(c == '+' ? jml_opcode::add : jml_opcode::sub, constant, rhs);
+			}
+		}
+
+		// term := factor (('*' | '/') factor)*
+		bool term(ref<bool> constant) {
+			if (!factor(constant)) return false;
+			for (;;) {
+				skip_space();
+				char c = peek();
+				if (c != '*' && c != '/') return true;
+				cur++;
+
+				bool rhs = false;
+				if (!factor(rhs)) return false;
+				binary(c == '*' ? jml_opcode::mul : jml_opcode::div, constant, rhs);
+			}
+		}
+
+		// factor := number | name ('.' name)* | '(' expr ')' | ('-' | '+') factor
+		bool factor(ref<bool> constant) {
+			skip_space();
+			char c = peek();
+			if (c == '(') {
+				cur++;
+				if (!expr(constant)) return false;
+				skip_space();
+				if (peek() != ')') return fail(jml_error::syntax);
+				cur++;
+				return true;
+			}
+
+			if (c == '-' || c == '+') {
+				cur++;
+				if (!factor(constant)) return false;
+				if (c == '+') return true;
+
+				auto& code = tape.program.code;
+				if (constant) {
+					code[code.size - 1].value = -code[code.size - 1].value;
+				} else {
+					tape.program.emit(jml_op{ jml_opcode::neg, 0, 0 });
+				}
+
+				return true;
+			}
+
+			if (jml_digit(c) || c == '.') {
+				f64 num = 0;
+				if (!number(num)) return false;
+				constant = true;
+				return push(jml_op{ jml_opcode::push, 0, num });
+			}
+
+			constant = false;
+			return reference();
+		}
+
+		bool push(cref<jml_op> op) {
+			if (++stack > jml_program::MAX_STACK) return fail(jml_error::too_deep);
+			tape.program.emit(op);
+			return true;
+		}
+
+		void binary(jml_opcode op, ref<bool> constant, bool rhs) {
+			stack--;
+			auto& code = tape.program.code;
+			if (constant && rhs) {
+				f64 b = code[code.size - 1].value;
+				code.size--;
+				code[code.size - 1].value = jml_apply(op, code[code.size - 1].value, b);
+				return;
+			}
+
+			tape.program.emit(jml_op{ op, 0, 0 });
+			constant = false;
+		}
+
+		bool number(ref<f64> out) {
+			if (!jml_number(cur, end, out)) return fail(jml_error::not_a_number);
+			return true;
+		}
+
+		// names resolve in the enclosing table first, then outwards up to the document
+		bool reference() {
+			core::stringview name;
+			if (!ident(name)) return false;
+
+			u32 n = JML_NONE;
+			u64 hash = 0;
+			for (i32 d = (i32)depth; d >= 0 && n == JML_NONE; d--) {
+				hash = jml_hash_child(scopes[d], name);
+				n = tape.lookup(hash, name);
+			}
+
+			while (n != JML_NONE && peek() == '.') {
+				cur++;
+				if (!ident(name)) return false;
+				if (tape.type(n) != jml_type::tbl) return fail(jml_error::unknown_key);
+				hash = jml_hash_child(hash, name);
+				n = tape.lookup(hash, name);
+			}
+
+			if (n == JML_NONE) return fail(jml_error::unknown_key);
+			if (tape.type(n) != jml_type::num) return fail(jml_error::not_a_number);
+
+			return push(jml_op{ jml_opcode::load, n, 0 });
+		}
+
+		ref<jml_tape> tape;
+		cref<jml_index> index;
+		cptr<char> base;
+		cptr<char> cur;
+		cptr<char> end;
+		u32 size;
+		u32 line;
+		jml_error error;
+		u64 scopes[JML_MAX_DEPTH]; // path hash of every open table, scopes[0] is the document
+		u32 depth;
+		u32 stack; // operands on the stack of the expression being compiled
+	};
+
+	jml_result jml_parse(ref<jml_tape> tape, core::stringview text) {
+		tape.clear(text);
+
+		// about one node per 16 bytes of text
+		tape.reserve(text.size / 16 + 1);
+
+		jml_index index;
+		jml_scan(index, (cptr<u8>)text.data, text.size);
+
+		jml_parser parser(tape, index, text.data, text.data + text.size);
+		u32 root = tape.add(jml_type::tbl, core::stringview());
+		parser.entries(root, 0);
+		tape.nodes[root].children.end = tape.nodes.size;
+		tape.program.finish();
+		return jml_result{ parser.error, parser.line };
+	}
+
+	// the scanner copies the tail block, it never reads past the end of the mapping
+	// the mapping replaces the tape's previous one only after the new one opened
+	jml_result jml_load(ref<jml_tape> tape, core::stringview path) {
+		core::file_map file(path);
+		if (!file.data) return jml_result{ jml_error::io, 0 };
+
+		tape.file = forward_data(file);
+		return jml_parse(tape, core::stringview((cptr<char>)tape.file.data, tape.file.size));
+	}
+
+	jml_val jml_build_value(cref<jml_view> tape, u32 n) {
+		jml_val res{};
+		switch (tape.type(n)) {
+			case jml_type::num: {
+				res = tape.num(n);
+				break;
+			}
+			case jml_type::boolean: {
+				res = tape.boolean(n);
+				break;
+			}
+			case jml_type::str: {
+				res = core::string(tape.str(n));
+				break;
+			}
+			case jml_type::arr: {
+				core::vector<jml_val> items(tape.size(n));
+				for (u32 c = tape.first(n); c < tape.end(n); c = tape.next(c)) {
+					items.add(jml_build_value(tape, c));
+				}
+
+				res = forward_data(items);
+				break;
+			}
+			default: break;
+		}
+
+		return res;
+	}
+
+	void jml_build(ref<jml_doc> doc, cref<jml_view> tape) {
+		JOLLY_ASSERT(doc.data.size == 0, "jml documents are built into an empty doc");
+		if (!tape.node_count) return;
+
+		if (doc.data.reserve < tape.node_count) {
+			doc.data.resize(tape.node_count);
+		}
+
+		struct frame {
+			u32 end;
+			cptr<jml_tbl> table;
+		};
+
+		frame stack[JML_MAX_DEPTH];
+		u32 depth = 0;
+		stack[0] = frame{ tape.end(0), nullptr };
+
+		for (u32 n = tape.first(0); n < tape.end(0);) {
+			while (n >= stack[depth].end) depth--;
+
+			jml_tbl key{ tape.key(n), stack[depth].table, &doc };
+			if (tape.type(n) != jml_type::tbl) {
+				doc.data.set(key, jml_build_value(tape, n));
+				n = tape.next(n);
+				continue;
+			}
+
+			// the table payload is heap allocated, children can point at it
+			JOLLY_ASSERT(depth + 1 < JML_MAX_DEPTH, "jml document is nested too deeply");
+			jml_val val{};
+			val = jml_tbl{ key };
+			cptr<jml_tbl> table = &val.raw<jml_tbl>();
+			doc.data.set(key, forward_data(val));
+			stack[++depth] = frame{ tape.end(n), table };
+			n = tape.first(n);
+		}
+	}
+
+	jml_result jml_parse(ref<jml_doc> doc, core::stringview text) {
+		JOLLY_ASSERT(doc.data.size == 0, "jml documents are parsed into an empty doc");
+		jml_result res = jml_parse(doc.tape, text);
+		if (res.error == jml_error::none) jml_build(doc, doc.tape);
+		return res;
+	}
+
+	// the first bytes decide the form, binary files skip the parser entirely
+	jml_result jml_load(ref<jml_doc> doc, core::stringview path) {
+		JOLLY_ASSERT(doc.data.size == 0, "jml documents are parsed into an empty doc");
+		core::file_map file(path);
+		if (!file.data) return jml_result{ jml_error::io, 0 };
+
+		if (jml_binary(file.data, file.size)) {
+			jml_result res = jml_open(doc.image, forward_data(file));
+			if (res.error == jml_error::none) jml_build(doc, doc.image);
+			return res;
+		}
+
+		doc.tape.file = forward_data(file);
+		jml_result res = jml_parse(doc.tape, core::stringview((cptr<char>)doc.tape.file.data, doc.tape.file.size));
+		if (res.error == jml_error::none) jml_build(doc, doc.tape);
+		return res;
+	}
+}
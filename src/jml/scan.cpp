@@ -0,0 +1,183 @@
+module;
+
+#include <core/core.h>
+#include <immintrin.h>
+
+module jolly.jml;
+import core.simd;
+
+// stage 1, classifies 64 bytes per step with avx2 and produces bitmaps the parser jumps through
+// strings are found with a prefix xor over unescaped quotes, blocks that also contain comments
+// are resolved by walking only the quote, hash and newline bits in order
+
+namespace jolly {
+	constexpr u64 JML_EVEN_BITS = 0x5555555555555555ull;
+
+	struct jml_block {
+		jml_block(cptr<u8> data) {
+			lo = _mm256_loadu_si256((cptr<__m256i>)data);
+			hi = _mm256_loadu_si256((cptr<__m256i>)(data + core::BLOCK_32));
+		}
+
+		__m256i eq(__m256i v, char c) const {
+			return _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c));
+		}
+
+		u64 mask(__m256i l, __m256i h) const {
+			return (u64)(u32)_mm256_movemask_epi8(l) | ((u64)(u32)_mm256_movemask_epi8(h) << 32);
+		}
+
+		u64 match(char c) const {
+			return mask(eq(lo, c), eq(hi, c));
+		}
+
+		u64 ops() const {
+			auto any = [&](__m256i v) {
+				__m256i a = _mm256_or_si256(eq(v, '='), eq(v, ','));
+				__m256i b = _mm256_or_si256(eq(v, '{'), eq(v, '}'));
+				__m256i c = _mm256_or_si256(eq(v, '['), eq(v, ']'));
+				return _mm256_or_si256(_mm256_or_si256(a, b), c);
+			};
+
+			return mask(any(lo), any(hi));
+		}
+
+		u64 space() const {
+			auto any = [&](__m256i v) {
+				return _mm256_or_si256(_mm256_or_si256(eq(v, ' '), eq(v, '\t')), eq(v, '\r'));
+			};
+
+			return mask(any(lo), any(hi));
+		}
+
+		__m256i lo;
+		__m256i hi;
+	};
+
+	// bits [beg, end)
+	u64 jml_range(u32 beg, u32 end) {
+		u64 upper = end >= 64 ? ~0ull : ((u64)1 << end) - 1;
+		return upper & ~(((u64)1 << beg) - 1);
+	}
+
+	u64 jml_prefix_xor(u64 x) {
+		x ^= x << 1;
+		x ^= x << 2;
+		x ^= x << 4;
+		x ^= x << 8;
+		x ^= x << 16;
+		x ^= x << 32;
+		return x;
+	}
+
+	// characters preceded by an odd run of backslashes, carry is set if the block ends in one
+	u64 jml_escaped(u64 backslash, ref<u64> carry) {
+		backslash &= ~carry;
+		u64 follows = (backslash << 1) | carry;
+		u64 starts = backslash & ~JML_EVEN_BITS & ~follows;
+
+		unsigned long long sequences = 0;
+		carry = _addcarry_u64(0, starts, backslash, &sequences);
+
+		u64 invert = sequences << 1;
+		return (JML_EVEN_BITS ^ invert) & follows;
+	}
+
+	struct jml_scanner {
+		jml_scanner()
+		: escape(0)
+		, in_string(false)
+		, in_comment(false) {}
+
+		// str gets string bodies including the opening quote, comment gets everything from
+		// a hash up to the newline, both carry over into the next block
+		void resolve(u64 quote, u64 hash, u64 newline, ref<u64> str, ref<u64> comment) {
+			if (!hash && !in_comment) {
+				str = jml_prefix_xor(quote) ^ (in_string ? ~0ull : 0);
+				in_string = (str >> 63) != 0;
+				comment = 0;
+				return;
+			}
+
+			str = 0;
+			comment = 0;
+			u32 open = 0;
+			u64 events = quote | hash | newline;
+			while (events) {
+				u32 p = core::tzcnt64(events);
+				u64 bit = (u64)1 << p;
+				events &= events - 1;
+
+				if (in_string) {
+					if (!(quote & bit)) continue;
+					str |= jml_range(open, p);
+					in_string = false;
+				} else if (in_comment) {
+					if (!(newline & bit)) continue;
+					comment |= jml_range(open, p);
+					in_comment = false;
+				} else if (quote & bit) {
+					in_string = true;
+					open = p;
+				} else if (hash & bit) {
+					in_comment = true;
+					open = p;
+				}
+			}
+
+			if (in_string) str |= jml_range(open, 64);
+			if (in_comment) comment |= jml_range(open, 64);
+		}
+
+		void block(cptr<u8> data, ref<u64> structural, ref<u64> space, ref<u64> backslash) {
+			jml_block in(data);
+			u64 slash = in.match('\\');
+			u64 quote = in.match('"') & ~jml_escaped(slash, escape);
+			u64 newline = in.match('\n');
+
+			u64 str = 0;
+			u64 comment = 0;
+			resolve(quote, in.match('#'), newline, str, comment);
+
+			// str covers the opening quote but not the closing one, both quotes stay structural
+			u64 body = str & ~quote;
+			structural = ((in.ops() | newline) & ~body & ~comment) | (quote & ~comment);
+			space = in.space() & ~str;
+			backslash = slash & str;
+		}
+
+		u64 escape;
+		bool in_string;
+		bool in_comment;
+	};
+
+	void jml_scan(ref<jml_index> index, cptr<u8> data, u32 size) {
+		// one spare word so lookups past the last byte stop on a zero
+		u32 words = size / core::BLOCK_64 + 2;
+		if (index.structural.reserve < words) {
+			index.structural.resize(words);
+			index.space.resize(words);
+			index.backslash.resize(words);
+		}
+
+		index.structural.size = index.space.size = index.backslash.size = words;
+		index.structural[words - 1] = index.space[words - 1] = index.backslash[words - 1] = 0;
+
+		jml_scanner scanner;
+		u32 i = 0;
+		u32 w = 0;
+		for (; i + core::BLOCK_64 <= size; i += core::BLOCK_64, w++) {
+			scanner.block(data + i, index.structural[w], index.space[w], index.backslash[w]);
+		}
+
+		// the tail is padded with zeros, they never match anything
+		alignas(core::BLOCK_32) u8 tail[core::BLOCK_64] = {};
+		core::copy8((ptr<u8>)data + i, tail, size - i);
+		scanner.block(tail, index.structural[w], index.space[w], index.backslash[w]);
+
+		u64 valid = jml_range(0, size - i);
+		index.structural[w] &= valid;
+		index.space[w] &= valid;
+		index.backslash[w] &= valid;
+	}
+}
@@ -0,0 +1,363 @@
+module;
+
+#include <core/core.h>
+
+module jolly.jml;
+
+// the stream reader follows the same grammar as the parser but never holds more than one read
+// buffer of the file, tokens are sliced out of the buffer and handed to the callbacks, the
+// unread tail is moved to the front before every read
+
+namespace jolly {
+	bool jml_delimiter(char c) {
+		return c == ',' || c == '\n' || c == '}' || c == ']' || c == '#';
+	}
+
+	bool jml_blank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	struct jml_streamer {
+		jml_streamer(ref<core::file_base> in, cref<jml_handler> h)
+		: file(in)
+		, handler(h)
+		, window()
+		, cur(0)
+		, line(1)
+		, depth(0)
+		, error(jml_error::none)
+		, eof(false)
+		, stopped(false) {}
+
+		ptr<char> base() const {
+			return (ptr<char>)(ptr<u8>)window.data;
+		}
+
+		bool fail(jml_error err) {
+			if (error == jml_error::none) error = err;
+			return false;
+		}
+
+		bool halt() {
+			stopped = true;
+			return false;
+		}
+
+		// drops the bytes before keep and reads more behind the rest, offsets shift down by keep
+		bool fill(u32 keep) {
+			if (eof) return false;
+			u32 rem = window.index - keep;
+			core::copy8(window.data + keep, window.data, rem);
+			window.index = rem;
+			cur -= keep;
+
+			if (!window.rem()) return fail(jml_error::too_long);
+			auto bytes = file.read(window);
+			if (!bytes || !bytes.get()) {
+				eof = true;
+				return false;
+			}
+
+			return true;
+		}
+
+		bool more() {
+			return cur < window.index || fill(cur);
+		}
+
+		char peek() {
+			return more() ? base()[cur] : 0;
+		}
+
+		void skip_space() {
+			while (jml_blank(peek())) cur++;
+			if (peek() != '#') return;
+			while (more() && base()[cur] != '\n') cur++;
+		}
+
+		void skip_lines() {
+			for (;;) {
+				skip_space();
+				if (peek() != '\n') return;
+				cur++;
+				line++;
+			}
+		}
+
+		// bytes from cur while pred holds, the end of the file also ends the token
+		template <typename F>
+		bool token(F pred, ref<core::stringview> out) {
+			u32 start = cur;
+			for (;;) {
+				while (cur < window.index && pred(base()[cur])) cur++;
+				if (cur < window.index) break;
+				if (!fill(start)) {
+					if (error != jml_error::none) return false;
+					break;
+				}
+
+				start = 0;
+			}
+
+			out = core::stringview(base() + start, cur - start);
+			return true;
+		}
+
+		bool ident(ref<core::stringview> out) {
+			if (!token(jml_ident, out)) return false;
+			if (!out.size) return fail(jml_error::syntax);
+			return true;
+		}
+
+		// entries up to close, close is 0 for the document itself
+		bool entries(char close) {
+			for (;;) {
+				skip_lines();
+				if (!more()) return close ? fail(jml_error::syntax) : error == jml_error::none;
+				char c = base()[cur];
+				if (c == close) {
+					cur++;
+					return true;
+				}
+
+				core::stringview name;
+				if (!ident(name)) return false;
+
+				jml_action act = handler.key ? handler.key(handler.user, name) : jml_action::next;
+				if (act == jml_action::stop) return halt();
+
+				skip_space();
+				if (peek() != '=') return fail(jml_error::syntax);
+				cur++;
+
+				if (!(act == jml_action::skip ? skip_value() : value())) return false;
+
+				skip_space();
+				c = peek();
+				if (c == ',') {
+					cur++;
+				} else if (c != '\n' && c != close) {
+					return fail(jml_error::syntax);
+				}
+			}
+		}
+
+		bool value() {
+			skip_space();
+			char c = peek();
+			if (c == '{') {
+				cur++;
+				return container(handler.begin_table, handler.end_table, '}');
+			}
+
+			if (c == '[') {
+				cur++;
+				return container(handler.begin_array, handler.end_array, ']');
+			}
+
+			return scalar();
+		}
+
+		bool container(pfn_jml_begin begin, pfn_jml_end end, char close) {
+			jml_action act = begin ? begin(handler.user) : jml_action::next;
+			if (act == jml_action::stop) return halt();
+			if (act == jml_action::skip) return skip_nested(1);
+			if (depth + 1 >= JML_MAX_DEPTH) return fail(jml_error::too_deep);
+
+			depth++;
+			bool res = close == '}' ? entries(close) : items();
+			depth--;
+			if (!res) return false;
+
+			if (end) end(handler.user);
+			return true;
+		}
+
+		bool items() {
+			for (;;) {
+				skip_lines();
+				char c = peek();
+				if (c == ']') {
+					cur++;
+					return true;
+				}
+
+				if (c == '{' || !c) return fail(jml_error::syntax);
+				if (!value()) return false;
+
+				skip_lines();
+				c = peek();
+				if (c == ',') {
+					cur++;
+				} else if (c != ']') {
+					return fail(jml_error::syntax);
+				}
+			}
+		}
+
+		bool scalar() {
+			jml_scalar val{};
+			if (peek() == '"') {
+				cur++;
+				if (!string(val.str)) return false;
+				val.type = jml_type::str;
+			} else {
+				core::stringview raw;
+				if (!token([](char c) { return !jml_delimiter(c); }, raw)) return false;
+
+				u32 size = raw.size;
+				while (size && jml_blank(raw.data[size - 1])) size--;
+				if (!size) return fail(jml_error::syntax);
+				classify(core::stringview(raw.data, size), val);
+			}
+
+			jml_action act = handler.value ? handler.value(handler.user, val) : jml_action::next;
+			return act == jml_action::stop ? halt() : true;
+		}
+
+		void classify(core::stringview raw, ref<jml_scalar> out) {
+			bool truth = raw == core::stringview("true");
+			if (truth || raw == core::stringview("false")) {
+				out.type = jml_type::boolean;
+				out.boolean = truth;
+				return;
+			}
+
+			cptr<char> p = raw.data;
+			cptr<char> last = raw.data + raw.size;
+			bool neg = *p == '-';
+			if (neg || *p == '+') p++;
+
+			f64 num = 0;
+			if (jml_number(p, last, num) && p == last) {
+				out.type = jml_type::num;
+				out.num = neg ? -num : num;
+				return;
+			}
+
+			out.type = jml_type::unk;
+			out.str = raw;
+		}
+
+		// the body is unescaped in place, escapes only shrink it
+		bool string(ref<core::stringview> out) {
+			u32 start = cur;
+			bool escape = false;
+			bool escaped = false;
+			for (;;) {
+				if (cur >= window.index) {
+					if (!fill(start)) return fail(jml_error::unterminated_string);
+					start = 0;
+					continue;
+				}
+
+				char c = base()[cur];
+				if (escape) {
+					escape = false;
+				} else if (c == '\\') {
+					escape = escaped = true;
+				} else if (c == '"') {
+					break;
+				}
+
+				cur++;
+			}
+
+			ptr<char> data = base() + start;
+			u32 size = cur++ - start;
+			if (escaped) {
+				u32 count = 0;
+				for (u32 i = 0; i < size; i++) {
+					char ch = data[i];
+					if (ch == '\\' && i + 1 < size) {
+						ch = data[++i];
+						ch = ch == 'n' ? '\n' : ch == 't' ? '\t' : ch;
+					}
+
+					data[count++] = ch;
+				}
+
+				size = count;
+			}
+
+			out = core::stringview(data, size);
+			return true;
+		}
+
+		bool skip_value() {
+			skip_space();
+			char c = peek();
+			if (c == '{' || c == '[') {
+				cur++;
+				return skip_nested(1);
+			}
+
+			if (c == '"') {
+				cur++;
+				return skip_string();
+			}
+
+			while (more() && !jml_delimiter(base()[cur])) cur++;
+			return error == jml_error::none;
+		}
+
+		// jumps over the rest of open containers, only brackets, strings and comments are looked
+		// at and nothing has to fit the buffer
+		bool skip_nested(u32 open) {
+			while (open) {
+				if (!more()) return fail(jml_error::syntax);
+				char c = base()[cur++];
+				if (c == '{' || c == '[') {
+					open++;
+				} else if (c == '}' || c == ']') {
+					open--;
+				} else if (c == '\n') {
+					line++;
+				} else if (c == '"') {
+					if (!skip_string()) return false;
+				} else if (c == '#') {
+					while (more() && base()[cur] != '\n') cur++;
+				}
+			}
+
+			return true;
+		}
+
+		bool skip_string() {
+			bool escape = false;
+			for (;;) {
+				if (!more()) return fail(jml_error::unterminated_string);
+				char c = base()[cur++];
+				if (escape) {
+					escape = false;
+				} else if (c == '\\') {
+					escape = true;
+				} else if (c == '"') {
+					return true;
+				}
+			}
+		}
+
+		ref<core::file_base> file;
+		cref<jml_handler> handler;
+		core::buffer window; // index is the number of valid bytes
+		u32 cur;
+		u32 line;
+		u32 depth;
+		jml_error error;
+		bool eof;
+		bool stopped;
+	};
+
+	jml_result jml_stream(ref<core::file_base> f, cref<jml_handler> handler) {
+		jml_streamer streamer(f, handler);
+		streamer.entries(0);
+		jml_error error = streamer.stopped ? jml_error::none : streamer.error;
+		return jml_result{ error, streamer.line };
+	}
+
+	jml_result jml_stream(core::stringview path, cref<jml_handler> handler) {
+		core::file_base f(path, core::access::ro);
+		return jml_stream(f, handler);
+	}
+}
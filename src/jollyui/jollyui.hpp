@@ -2,6 +2,8 @@ export module jolly.ui;
 import core.types;
 import core.string;
 import math.vec;
+import jolly.jml;
+import jolly.jml_bind;
 
 export namespace jolly {
 	struct ui_context;
@@ -44,4 +46,18 @@ export namespace jolly {
 		math::vec4f text_select;
 		core::string text_font;
 	};
+
+	template <>
+	struct jml_schema<ui_defaults> {
+		static constexpr jml_field fields[] = {
+			jml_bind<&ui_defaults::background>("background"),
+			jml_bind<&ui_defaults::element_foreground>("element_foreground"),
+			jml_bind<&ui_defaults::element_background>("element_background"),
+			jml_bind<&ui_defaults::element_hover>("element_hover"),
+			jml_bind<&ui_defaults::element_select>("element_select"),
+			jml_bind<&ui_defaults::text_color>("text_color"),
+			jml_bind<&ui_defaults::text_select>("text_select"),
+			jml_bind<&ui_defaults::text_font>("text_font"),
+		};
+	};
 };
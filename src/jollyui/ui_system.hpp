@@ -14,10 +14,15 @@ import jolly.components;
 import jolly.render_graph;
 import jolly.render_thread;
 import jolly.ecs;
+import jolly.jml;
+import jolly.jml_bind;
 
 export namespace jolly {
 	struct ui_system : public system {
-		ui_system() {
+		static constexpr cstr DEFAULTS = "../assets/ui.jml";
+
+		ui_system()
+		: _defaults() {
 			LOG_INFO("UI system");
 		}
 
@@ -26,6 +31,8 @@ export namespace jolly {
 		}
 
 		virtual void init() {
+			update_defaults();
+
 			auto ui_render = [](ref<ui_context> ui, f32 ms) {
 				if (ui.button("press me!")) {
 					LOG_INFO("button pressed");
@@ -129,8 +136,22 @@ export namespace jolly {
 			graph.add("ui", renderui);
 		}
 
-		ref<ui_defaults> defaults();
-		void update_defaults();
+		ref<ui_defaults> defaults() {
+			return _defaults;
+		}
+
+		// bound straight from the tape through jml_schema<ui_defaults>, keys missing from the
+		// file keep their current value
+		void update_defaults() {
+			jml_tape tape;
+			jml_result res = jml_load(tape, DEFAULTS);
+			if (res.error != jml_error::none) {
+				LOG_WARN("failed to load % at line %", DEFAULTS, res.line);
+				return;
+			}
+
+			jml_bind_path(tape, "defaults", _defaults);
+		}
 
 		ui_defaults _defaults;
 	};
@@ -13,6 +13,7 @@ import core.lock;
 import core.memory;
 import core.tuple;
 import math.vec;
+import jolly.extract;
 
 export namespace jolly {
 	struct render_graph;
@@ -22,6 +23,7 @@ export namespace jolly {
 		render_graph()
 		: nodes()
 		, graph()
+		, frame(nullptr)
 		, busy() {
 			// present all swapchains
 			auto root = [](ref<render_graph> graph) {
@@ -48,9 +50,10 @@ export namespace jolly {
 			// use additional input/output information to order graphs
 		}
 
-		// render
-		void execute() {
+		// render, nodes read the scene from in until the next execute
+		void execute(cref<render_frame> in) {
 			core::lock lock(busy);
+			frame = &in;
 		}
 
 		// rendering commands
@@ -108,6 +111,7 @@ export namespace jolly {
 
 		core::table<core::string, pfn_render_node> nodes;
 		core::table<core::string, core::vector<core::string>> graph;
+		cptr<render_frame> frame; // latest extracted frame
 		core::mutex busy;
 	};
 }
@@ -9,6 +9,7 @@ import core.memory;
 import core.timer;
 import core.log;
 import jolly.engine;
+import jolly.extract;
 import jolly.system;
 import jolly.render_graph;
 import vulkan.device;
@@ -42,6 +43,7 @@ export namespace jolly {
 
 			while (run) {
 				core::timer timer(dt);
+				_graph.execute(engine::instance().extracted());
 				_device->step(dt);
 				run = _run.get(core::memory_order_relaxed);
 			}
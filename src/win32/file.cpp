@@ -5,6 +5,7 @@ module;
 #include <fcntl.h>
 #include <io.h>
 #include <stdio.h>
+#include <windows.h>
 
 module core.file;
 
@@ -60,6 +61,80 @@ namespace core {
 		_commit(fd);
 	}
 
+	file_map::file_map(stringview fname)
+	: data(nullptr), size(0), handle() {
+		HANDLE f = CreateFileA(string(fname), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (f == INVALID_HANDLE_VALUE) return;
+
+		LARGE_INTEGER bytes{};
+		GetFileSizeEx(f, &bytes);
+
+		// empty files cannot be mapped, the mapping keeps the file open on its own
+		HANDLE mapping = bytes.QuadPart ? CreateFileMappingA(f, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		CloseHandle(f);
+		if (!mapping) return;
+
+		ptr<void> view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view) {
+			CloseHandle(mapping);
+			return;
+		}
+
+		data = (cptr<u8>)view;
+		size = (u32)bytes.QuadPart;
+		handle = (ptr<void>)mapping;
+	}
+
+	file_map::~file_map() {
+		if (data) UnmapViewOfFile(data);
+		if (handle) CloseHandle((HANDLE)handle.data());
+	}
+
+	u64 fmodified(stringview fname) {
+		WIN32_FILE_ATTRIBUTE_DATA info{};
+		if (!GetFileAttributesExA(string(fname), GetFileExInfoStandard, &info)) return 0;
+		return ((u64)info.ftLastWriteTime.dwHighDateTime << 32) | info.ftLastWriteTime.dwLowDateTime;
+	}
+
+	fwatch::~fwatch() {
+		for (ptr<void> h : handles) {
+			FindCloseChangeNotification((HANDLE)h);
+		}
+	}
+
+	void fwatch::add(stringview fname) {
+		u32 size = fname.size;
+		while (size && fname.data[size - 1] != '/' && fname.data[size - 1] != '\\') size--;
+		stringview dir = size ? stringview(fname.data, size) : stringview(".");
+
+		for (auto& other : dirs) {
+			if ((stringview)other == dir) return;
+		}
+
+		JOLLY_ASSERT(handles.size < MAXIMUM_WAIT_OBJECTS, "too many watched directories");
+		HANDLE h = FindFirstChangeNotificationA(string(dir), FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+		if (h == INVALID_HANDLE_VALUE) return;
+
+		handles.add((ptr<void>)h);
+		dirs.add(string(dir));
+	}
+
+	bool fwatch::wait(u32 ms) {
+		if (!handles.size) {
+			Sleep(ms);
+			return false;
+		}
+
+		DWORD res = WaitForMultipleObjects(handles.size, (cptr<HANDLE>)handles.data, FALSE, ms);
+		if (res < WAIT_OBJECT_0 || res >= WAIT_OBJECT_0 + handles.size) return false;
+
+		for (ptr<void> h : handles) {
+			if (WaitForSingleObject((HANDLE)h, 0) == WAIT_OBJECT_0) FindNextChangeNotification((HANDLE)h);
+		}
+
+		return true;
+	}
+
 	int convert_flags(access _access) {
 		int read = 0;
 		read |= cast<bool>(_access & access::ro) ? _O_RDONLY : 0;
@@ -69,6 +144,7 @@ namespace core {
 		int oflag = read;
 		oflag |= cast<bool>(_access & access::txt) ? _O_TEXT : _O_BINARY;
 		oflag |= cast<bool>(_access & access::app) ? _O_APPEND : 0;
+		oflag |= cast<bool>(_access & access::trunc) ? _O_TRUNC : 0;
 		return oflag;
 	}
 
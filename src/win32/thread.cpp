@@ -53,4 +53,10 @@ namespace core {
 	void thread::sleep(int ms) const {
 		Sleep(ms);
 	}
+
+	u32 hardware_threads() {
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		return (u32)info.dwNumberOfProcessors;
+	}
 }
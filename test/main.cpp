@@ -1,6 +1,7 @@
 #include <core/core.h>
 #include <iostream>
 #include <string>
+#include <cstdio>
 
 import core.types;
 import core.vector;
@@ -15,9 +16,22 @@ import core.atom;
 import core.format;
 import core.iterator;
 import core.file;
+import core.timer;
+import core.simd;
 
 import jolly.jml;
+import jolly.jml_bind;
+import jolly.reload;
 import jolly.ecs;
+import jolly.snapshot;
+import jolly.extract;
+import jolly.parallel;
+import jolly.column;
+import jolly.spatial;
+import jolly.transform;
+import jolly.prefab;
+import jolly.components;
+import math.vec;
 import jolly.spirv.parser;
 
 using namespace core;
@@ -286,6 +300,488 @@ void test_ecs() {
 		test_component1& t1r = test1;
 		LOG_INFO("entity: %, name: %, a: %", entity._id, test2->name, test1->a);
 	}
+
+	LOG_INFO("ecs.owning_group");
+	auto& owning = ecs.owning_group<test_component1, test_component2>();
+	ecs.del<test_component2>(jolly::e_id{2});
+	for (auto [entity, components] : core::wview_create(owning)) {
+		auto [test1, test2] = components;
+		LOG_INFO("entity: %, name: %, a: %", entity._id, test2->name, test1->a);
+	}
+
+	for (u32 i : range(owning.size)) {
+		JOLLY_ASSERT(ecs.view<test_component1>().set.dense[i] == ecs.view<test_component2>().set.dense[i]);
+	}
+
+	LOG_INFO("sparse_set pages");
+	jolly::sparse_set sparse;
+	sparse.add(jolly::e_id{ 1 << 20 });
+	JOLLY_ASSERT(sparse.has(jolly::e_id{ 1 << 20 }));
+	JOLLY_ASSERT(!sparse.has(jolly::e_id{ 7 }));
+	JOLLY_ASSERT(sparse.pages[0] == jolly::sparse_null_page());
+}
+
+void test_ecs_commands() {
+	LOG_INFO("% ecs commands", DIVIDE);
+	jolly::ecs ecs;
+	jolly::e_id e = ecs.create();
+	ecs.add<test_component1>(e, test_component1{1, 2, 3});
+
+	jolly::ecs_commands cmds;
+	jolly::e_id pending = cmds.create();
+	cmds.add<test_component1>(pending, test_component1{4, 5, 6});
+	cmds.add<test_component2>(pending, test_component2{"deferred", 7});
+	cmds.del<test_component1>(e);
+	cmds.destroy(e);
+
+	ecs.submit(forward_data(cmds));
+	JOLLY_ASSERT(ecs.view<test_component1>().has(e));
+
+	ecs.flush();
+	JOLLY_ASSERT(!ecs.view<test_component1>().has(e));
+	for (auto [entity, components] : ecs.group<test_component1, test_component2>()) {
+		auto [test1, test2] = components;
+		LOG_INFO("entity: %, name: %, a: %", entity._id, test2->name, test1->a);
+	}
+
+	// lvalues are queued by copy, assigning over a buffer drops what it still holds
+	jolly::ecs_commands pending_cmds;
+	test_component2 named{"dropped", 8};
+	pending_cmds.add(pending_cmds.create(), named);
+	JOLLY_ASSERT(pending_cmds.commands.size == 2);
+
+	pending_cmds = jolly::ecs_commands();
+	JOLLY_ASSERT(!pending_cmds.commands.size && !pending_cmds.created);
+}
+
+void test_ecs_bulk() {
+	LOG_INFO("% ecs bulk", DIVIDE);
+	jolly::ecs ecs;
+	core::vector<jolly::e_id> entities = ecs.create_n(100000);
+
+	core::vector<test_component1> components(entities.size);
+	for (u32 i : range(entities.size)) {
+		components.add(test_component1{ (int)i, 0, 0 });
+	}
+
+	ecs.add_n<test_component1>(entities, components);
+	JOLLY_ASSERT(ecs.view<test_component1>().get(entities[500]).a == 500);
+
+	core::vector<jolly::e_id> clones(16);
+	clones.size = 16;
+	ecs.clone_n(entities[7], clones);
+	JOLLY_ASSERT(ecs.view<test_component1>().get(clones[15]).a == 7);
+
+	ecs.destroy_n(entities);
+	LOG_INFO("remaining test_component1: %", ecs.view<test_component1>().set.dense.size);
+}
+
+void test_ecs_tracking() {
+	LOG_INFO("% ecs change tracking", DIVIDE);
+	jolly::ecs ecs;
+	ecs.track<test_component1>();
+
+	core::vector<jolly::e_id> entities = ecs.create_n(8);
+	for (jolly::e_id e : entities) {
+		ecs.add<test_component1>(e, test_component1{ 0, 0, 0 });
+	}
+
+	u32 last = ecs.advance();
+	ecs.patch<test_component1>(entities[3]).a = 3;
+	ecs.patch<test_component1>(entities[5]).a = 5;
+
+	u32 count = 0;
+	for (auto [entity, component] : ecs.filter<jolly::changed<test_component1>>(last)) {
+		LOG_INFO("changed entity: %, a: %", entity._id, component->a);
+		count++;
+	}
+
+	JOLLY_ASSERT(count == 2);
+	for (auto [entity, component] : ecs.filter<jolly::added<test_component1>>(last)) {
+		JOLLY_ASSERT(false, "nothing was added since last");
+	}
+}
+
+void test_ecs_observers() {
+	LOG_INFO("% ecs observers", DIVIDE);
+	jolly::ecs ecs;
+
+	static u32 matched = 0;
+	auto observer = [](ref<jolly::ecs> state, cptr<jolly::e_id> e, u32 count, jolly::ecs_event event) {
+		matched += count;
+	};
+
+	ecs.observe<test_component1, test_component2>(jolly::ecs_event::add, observer);
+
+	core::vector<jolly::e_id> entities = ecs.create_n(4);
+	for (jolly::e_id e : entities) {
+		ecs.add<test_component1>(e, test_component1{ 1, 2, 3 });
+	}
+
+	JOLLY_ASSERT(matched == 0);
+	ecs.add<test_component2>(entities[1], test_component2{ "observed", 1 });
+	JOLLY_ASSERT(matched == 1);
+
+	// the same callback observed twice is two observers, each runs once per batch
+	ecs.observe<test_component1, test_component2>(jolly::ecs_event::add, observer);
+	core::vector<jolly::e_id> clones(2);
+	clones.size = 2;
+	ecs.clone_n(entities[1], clones);
+	JOLLY_ASSERT(matched == 5);
+}
+
+void test_ecs_query() {
+	LOG_INFO("% ecs query", DIVIDE);
+	jolly::ecs ecs;
+
+	core::vector<jolly::e_id> entities = ecs.create_n(10);
+	for (u32 i : range(entities.size)) {
+		ecs.add<test_component1>(entities[i], test_component1{ (int)i, 0, 0 });
+		if (i % 2) ecs.add<test_component2>(entities[i], test_component2{ "excluded", (int)i });
+	}
+
+	auto& q = ecs.query<jolly::with<test_component1>, jolly::without<test_component2>>();
+	JOLLY_ASSERT(q.matches.size == 5);
+	for (auto [entity, components] : core::rview_create(q)) {
+		auto [test1] = components;
+		JOLLY_ASSERT(test1->a % 2 == 0);
+	}
+
+	// cached until a pool changes
+	ptr<jolly::e_id> data = q.matches.data;
+	ecs.query<jolly::with<test_component1>, jolly::without<test_component2>>();
+	JOLLY_ASSERT(q.matches.data == data && q.matches.size == 5);
+
+	ecs.del<test_component2>(entities[1]);
+	ecs.query<jolly::with<test_component1>, jolly::without<test_component2>>();
+	JOLLY_ASSERT(q.matches.size == 6);
+}
+
+void test_ecs_snapshot() {
+	LOG_INFO("% ecs snapshot", DIVIDE);
+	jolly::snapshot_registry registry;
+	registry.add<test_component1>("test_component1", 1);
+
+	{
+		jolly::ecs ecs;
+		core::vector<jolly::e_id> entities = ecs.create_n(1000);
+		for (u32 i : range(entities.size)) {
+			ecs.add<test_component1>(entities[i], test_component1{ (int)i, 1, 2 });
+		}
+
+		ecs.destroy(entities[10]);
+		auto f = fopen("snapshot.bin", core::access::wo);
+		jolly::snapshot_save(ecs, registry, f);
+	}
+
+	jolly::ecs ecs;
+	auto f = fopen("snapshot.bin", core::access::ro);
+	JOLLY_ASSERT(jolly::snapshot_load(ecs, registry, f) == jolly::snapshot_error::none);
+	JOLLY_ASSERT(ecs.view<test_component1>().set.dense.size == 999);
+	JOLLY_ASSERT(ecs.get<test_component1>(ecs.entities[500]).a == 500);
+
+	// the free list survives, the destroyed slot is reused first
+	JOLLY_ASSERT(ecs.create().id() == 10);
+
+	jolly::snapshot_registry newer;
+	newer.add<test_component1>("test_component1", 2);
+	jolly::ecs stale;
+	auto f2 = fopen("snapshot.bin", core::access::ro);
+	JOLLY_ASSERT(jolly::snapshot_load(stale, newer, f2) == jolly::snapshot_error::type_mismatch);
+
+	// a file cut inside the last column is rejected before the ecs is touched
+	{
+		core::vector<u8> bytes{};
+		auto src = fopen("snapshot.bin", core::access::ro);
+		src.read(bytes);
+
+		auto dst = fopen("snapshot_cut.bin", core::access::wo);
+		dst.write(core::membuf{ bytes.data, bytes.size - 64 });
+	}
+
+	jolly::ecs cut;
+	auto f3 = fopen("snapshot_cut.bin", core::access::ro);
+	JOLLY_ASSERT(jolly::snapshot_load(cut, registry, f3) == jolly::snapshot_error::truncated);
+	JOLLY_ASSERT(cut.entities.size == 0 && cut.tick == 1);
+
+	// a signature bit without a pool entry, or an entity listed twice, is rejected as well
+	auto tamper = [&](auto edit) {
+		core::vector<u8> bytes{};
+		{
+			auto src = fopen("snapshot.bin", core::access::ro);
+			src.read(bytes);
+		}
+
+		u32 entities = jolly::snapshot_align(jolly::snapshot_align(sizeof(jolly::snapshot_header)) + sizeof(jolly::snapshot_column));
+		u32 signatures = entities + jolly::snapshot_align(1000 * sizeof(jolly::e_id));
+		u32 dense = signatures + jolly::snapshot_align(1000 * sizeof(u64)) + jolly::snapshot_align(sizeof(u32));
+		edit((ptr<u64>)&bytes[signatures], (ptr<jolly::e_id>)&bytes[dense]);
+		{
+			auto dst = fopen("snapshot_bad.bin", core::access::wo);
+			dst.write(core::membuf{ bytes.data, bytes.size });
+		}
+
+		jolly::ecs bad;
+		auto in = fopen("snapshot_bad.bin", core::access::ro);
+		jolly::snapshot_error error = jolly::snapshot_load(bad, registry, in);
+		JOLLY_ASSERT(bad.entities.size == 0);
+		return error;
+	};
+
+	JOLLY_ASSERT(tamper([](ptr<u64> signatures, ptr<jolly::e_id> dense) { signatures[0] |= 2; }) == jolly::snapshot_error::bad_entity);
+	JOLLY_ASSERT(tamper([](ptr<u64> signatures, ptr<jolly::e_id> dense) { dense[1] = dense[0]; }) == jolly::snapshot_error::bad_entity);
+}
+
+void test_ecs_sort() {
+	LOG_INFO("% ecs sort", DIVIDE);
+	jolly::ecs ecs;
+	core::vector<jolly::e_id> entities = ecs.create_n(64);
+	for (u32 i : range(entities.size)) {
+		ecs.add<test_component1>(entities[i], test_component1{ (int)((i * 37) % 64), 0, 0 });
+		ecs.add<test_component2>(entities[entities.size - i - 1], test_component2{ "sorted", (int)i });
+	}
+
+	ecs.sort<test_component1>([](cref<test_component1> a, cref<test_component1> b) { return a.a < b.a; });
+	auto& pool1 = ecs.view<test_component1>();
+	for (u32 i : range(pool1.components.size)) {
+		JOLLY_ASSERT(pool1.components[i].a == (int)i);
+		JOLLY_ASSERT(pool1.get(pool1.set.dense[i]).a == (int)i);
+	}
+
+	ecs.sort_as<test_component2, test_component1>();
+	auto& pool2 = ecs.view<test_component2>();
+	for (u32 i : range(pool2.set.dense.size)) {
+		JOLLY_ASSERT(pool2.set.dense[i] == pool1.set.dense[i]);
+	}
+}
+
+void test_ecs_column() {
+	LOG_INFO("% ecs columns", DIVIDE);
+	jolly::ecs ecs;
+	core::vector<jolly::e_id> entities = ecs.create_n(21);
+	for (u32 i : range(entities.size)) {
+		f32 x = (f32)i;
+		ecs.add<jolly::quad_component>(entities[i], jolly::quad_component{ { x, -x }, { 1, 1 }, { 0, 0, 0 } });
+	}
+
+	auto& pool = ecs.view<jolly::quad_component>();
+	auto pos = jolly::column_of(pool, &jolly::quad_component::pos);
+	JOLLY_ASSERT(jolly::column_sum(pos.field(&math::vec2f::x)) == 210.0f);
+
+	jolly::aabb2f box = jolly::column_aabb(pos);
+	JOLLY_ASSERT(box.min.x == 0.0f && box.max.x == 20.0f);
+	JOLLY_ASSERT(box.min.y == -20.0f && box.max.y == 0.0f);
+
+	jolly::column_affine(pos, math::vec2f{ 2, 1 }, math::vec2f{ 0, 5 });
+	JOLLY_ASSERT(pool.components[20].pos.x == 40.0f && pool.components[20].pos.y == -15.0f);
+	JOLLY_ASSERT(pool.components[20].scale.x == 1.0f);
+
+	// kernels on a tracked pool stamp every component they wrote
+	ecs.track<jolly::quad_component>();
+	u32 last = ecs.advance();
+	auto scale = jolly::column_of(pool, &jolly::quad_component::scale);
+	jolly::column_affine(scale.field(&math::vec2f::x), 2, 0);
+
+	u32 changed = 0;
+	for (auto [e, quad] : ecs.filter<jolly::changed<jolly::quad_component>>(last)) {
+		changed++;
+	}
+
+	JOLLY_ASSERT(changed == 21);
+}
+
+void test_spatial() {
+	LOG_INFO("% spatial index", DIVIDE);
+	jolly::ecs ecs;
+	core::vector<jolly::e_id> entities = ecs.create_n(100);
+	for (u32 i : range(entities.size)) {
+		f32 x = (f32)(i % 10) * 10.0f;
+		f32 y = (f32)(i / 10) * 10.0f;
+		ecs.add<jolly::quad_component>(entities[i], jolly::quad_component{ { x, y }, { 2, 2 }, { 0, 0, 0 } });
+	}
+
+	jolly::spatial_index grid(jolly::spatial_mode::grid, 16.0f);
+	jolly::spatial_index bvh(jolly::spatial_mode::bvh);
+	grid.update(ecs);
+	bvh.update(ecs);
+
+	u32 hits = 0;
+	jolly::aabb2f box{ { -1, -1 }, { 21, 11 } };
+	grid.query(box, [&](jolly::e_id e) { hits++; });
+	JOLLY_ASSERT(hits == 6);
+
+	hits = 0;
+	bvh.query(box, [&](jolly::e_id e) { hits++; });
+	JOLLY_ASSERT(hits == 6);
+
+	hits = 0;
+	bvh.query_ray({ -5, 0 }, { 1, 0 }, 200, [&](jolly::e_id e) { hits++; });
+	JOLLY_ASSERT(hits == 10);
+
+	// moves are picked up through the change ticks
+	ecs.advance();
+	ecs.patch<jolly::quad_component>(entities[0]).pos = math::vec2f{ 500, 500 };
+	ecs.destroy(entities[1]);
+	grid.update(ecs);
+
+	hits = 0;
+	grid.query_radius({ 0, 0 }, 12, [&](jolly::e_id e) { hits++; });
+	JOLLY_ASSERT(hits == 1);
+
+	// update advances the tick itself, a patch right after it is not lost
+	ecs.patch<jolly::quad_component>(entities[0]).pos = math::vec2f{ 0, 0 };
+	grid.update(ecs);
+
+	hits = 0;
+	grid.query_radius({ 0, 0 }, 12, [&](jolly::e_id e) { hits++; });
+	JOLLY_ASSERT(hits == 2);
+
+	// a recycled id does not inherit the cell of its last owner
+	ecs.destroy(entities[2]);
+	jolly::e_id recycled = ecs.create();
+	ecs.add<jolly::quad_component>(recycled, jolly::quad_component{ { 300, 300 }, { 40, 40 }, { 0, 0, 0 } });
+	grid.update(ecs);
+	JOLLY_ASSERT(grid.grid.loose == 20.0f);
+
+	hits = 0;
+	grid.query_radius({ 20, 0 }, 3, [&](jolly::e_id e) { hits++; });
+	JOLLY_ASSERT(hits == 0);
+
+	// loose bounds shrink back once the largest quad is gone
+	ecs.destroy(recycled);
+	grid.update(ecs);
+	JOLLY_ASSERT(grid.grid.loose == 1.0f);
+}
+
+void test_transform() {
+	LOG_INFO("% transform hierarchy", DIVIDE);
+	jolly::ecs ecs;
+	core::vector<jolly::e_id> entities = ecs.create_n(3);
+	for (jolly::e_id e : entities) {
+		ecs.add<jolly::transform_component>(e, jolly::transform_component{ { 10, 0 }, { 1, 1 }, 0 });
+		ecs.add<jolly::quad_component>(e, jolly::quad_component{ { 0, 0 }, { 1, 1 }, { 0, 0, 0 } });
+	}
+
+	// a chain root -> child -> grandchild, each offset by 10 along x
+	ecs.add<jolly::hierarchy_component>(entities[1], jolly::hierarchy_component{ entities[0] });
+	ecs.add<jolly::hierarchy_component>(entities[2], jolly::hierarchy_component{ entities[1] });
+
+	jolly::transform_system transforms;
+	transforms.update(ecs);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(entities[2]).pos.x == 30.0f);
+
+	ecs.advance();
+	ecs.patch<jolly::transform_component>(entities[0]).scale = math::vec2f{ 2, 2 };
+	transforms.update(ecs);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(entities[2]).pos.x == 50.0f);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(entities[2]).scale.x == 2.0f);
+
+	// reparenting only touches the hierarchy pool, the grandchild now hangs off the root
+	ecs.patch<jolly::hierarchy_component>(entities[2]).parent = entities[0];
+	transforms.update(ecs);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(entities[2]).pos.x == 30.0f);
+
+	// many independent roots, each subtree propagates on its own
+	core::vector<jolly::e_id> roots = ecs.create_n(600);
+	for (u32 i : range(roots.size)) {
+		ecs.add<jolly::transform_component>(roots[i], jolly::transform_component{ { (f32)i, 0 }, { 1, 1 }, 0 });
+		ecs.add<jolly::quad_component>(roots[i], jolly::quad_component{ { 0, 0 }, { 1, 1 }, { 0, 0, 0 } });
+		if (i % 2) ecs.add<jolly::hierarchy_component>(roots[i], jolly::hierarchy_component{ roots[i - 1] });
+	}
+
+	JOLLY_ASSERT(transforms.update(ecs) == jolly::transform_error::none);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(roots[599]).pos.x == 598.0f + 599.0f);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(entities[2]).pos.x == 30.0f);
+
+	// a parent cycle is reported and its nodes are left alone, the rest still propagates
+	ecs.patch<jolly::hierarchy_component>(entities[1]).parent = entities[2];
+	ecs.add<jolly::hierarchy_component>(entities[0], jolly::hierarchy_component{ entities[1] });
+	ecs.patch<jolly::transform_component>(roots[0]).pos = math::vec2f{ 100, 0 };
+	JOLLY_ASSERT(transforms.update(ecs) == jolly::transform_error::cycle);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(roots[1]).pos.x == 101.0f);
+	JOLLY_ASSERT(ecs.view<jolly::quad_component>().get(entities[2]).pos.x == 30.0f);
+}
+
+void test_prefab() {
+	LOG_INFO("% prefab instancing", DIVIDE);
+	jolly::ecs ecs;
+	auto& group = ecs.group<test_component1, jolly::quad_component>();
+
+	jolly::prefab base;
+	base.add(test_component1{ 1, 2, 3 });
+	base.add(jolly::quad_component{ { 0, 0 }, { 4, 4 }, { 1, 0, 0 } });
+
+	core::vector<jolly::e_id> entities = base.instantiate(ecs, 1000);
+	JOLLY_ASSERT(ecs.view<test_component1>().get(entities[999]).c == 3);
+	JOLLY_ASSERT(group.set.dense.size == 1000);
+
+	jolly::jml_doc doc;
+	doc["enemy"]["quad"]["scale"] = jolly::jml_vector({ 16.0, 8.0 });
+	doc["enemy"]["transform"]["rotation"] = 0.5;
+
+	jolly::prefab_registry registry;
+	registry.add<jolly::quad_component>("quad");
+	registry.add<jolly::transform_component>("transform");
+
+	jolly::prefab enemy = registry.load(doc, "enemy");
+	JOLLY_ASSERT(enemy.get<jolly::quad_component>()->scale.y == 8.0f);
+
+	core::vector<jolly::e_id> enemies = enemy.instantiate(ecs, 16);
+	JOLLY_ASSERT(ecs.view<jolly::transform_component>().get(enemies[15]).rotation == 0.5f);
+	JOLLY_ASSERT(group.set.dense.size == 1000);
+
+	// lvalues are stored under their plain type, assigning over a prefab drops its components
+	jolly::prefab copy;
+	test_component1 item{ 4, 5, 6 };
+	copy.add(item);
+	JOLLY_ASSERT(copy.has<test_component1>() && copy.get<test_component1>()->c == 6);
+
+	copy = forward_data(enemy);
+	JOLLY_ASSERT(!copy.has<test_component1>() && copy.has<jolly::quad_component>());
+}
+
+void test_par_each() {
+	LOG_INFO("% parallel ecs iteration", DIVIDE);
+	jolly::ecs ecs;
+	core::vector<jolly::e_id> entities = ecs.create_n(100000);
+	core::vector<test_component1> components(entities.size);
+	for (u32 i : range(entities.size)) {
+		components.add(test_component1{ 1, 0, 0 });
+	}
+
+	ecs.add_n<test_component1>(entities, components);
+
+	auto& pool = ecs.view<test_component1>();
+	jolly::par_each(pool, [](jolly::e_id e, auto component) {
+		component->a += 1;
+	});
+
+	auto sum = [](ref<i64> acc, jolly::e_id e, auto component) {
+		acc += component->a;
+	};
+
+	auto combine = [](ref<i64> acc, cref<i64> other) {
+		acc += other;
+	};
+
+	i64 total = jolly::par_reduce(pool, (i64)0, sum, combine);
+	JOLLY_ASSERT(total == 200000);
+}
+
+void test_triple_buffer() {
+	LOG_INFO("% triple buffer", DIVIDE);
+	jolly::triple_buffer<u32> frames;
+	JOLLY_ASSERT(!frames.acquire());
+
+	frames.write_slot() = 1;
+	frames.publish();
+	frames.write_slot() = 2;
+	frames.publish();
+
+	// the consumer skips straight to the newest frame
+	JOLLY_ASSERT(frames.acquire());
+	JOLLY_ASSERT(frames.read_slot() == 2);
+	JOLLY_ASSERT(!frames.acquire());
 }
 
 void test_convert() {
@@ -384,11 +880,473 @@ void test_jml() {
 	jml_dump(doc, f);
 }
 
+void test_jml_parse() {
+	LOG_INFO("% jml parse", DIVIDE);
+	jolly::jml_doc doc;
+	auto res = jolly::jml_load(doc, "../test/test.jml");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	JOLLY_ASSERT(doc["mydict"]["inner"]["myval"].get<f64>() == 4.0);
+	JOLLY_ASSERT(doc["mystring"].get<core::string>() == core::string("hello world"));
+	JOLLY_ASSERT(doc["thisvalue"].get<f64>() == 16.0);
+	JOLLY_ASSERT(doc["myeval"].get<f64>() == -4.0);
+	JOLLY_ASSERT(doc["myarray"].size() == 4);
+
+	// quotes in comments and structural characters in strings must not confuse stage 1
+	jolly::jml_doc tricky;
+	res = jolly::jml_parse(tricky, "a = 1 # \"not a string, {\nb = \"x # { \\\" ]\"\nc = a + 1\n");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	JOLLY_ASSERT(tricky["b"].get<core::string>() == core::string("x # { \" ]"));
+	JOLLY_ASSERT(tricky["c"].get<f64>() == 2.0);
+
+	// keys and plain strings point into the text, only escaped strings are copied
+	core::stringview source("k = \"plain\"\ne = \"a\\tb\"\n");
+	jolly::jml_tape spans;
+	res = jolly::jml_parse(spans, source);
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+
+	u32 k = spans.lookup(jolly::jml_hash_child(jolly::JML_HASH_SEED, "k"), "k");
+	u32 e = spans.lookup(jolly::jml_hash_child(jolly::JML_HASH_SEED, "e"), "e");
+	JOLLY_ASSERT(spans.key(k).data == source.data && spans.str(k).data == source.data + 5);
+	JOLLY_ASSERT(spans.str(e) == core::stringview("a\tb") && spans.pool.size == 3);
+
+	// node keys store a u16 size, longer keys are an error instead of being cut short
+	core::vector<char> wide(70016);
+	for (u32 i : range(70000)) wide.add('k');
+	for (char c : core::stringview(" = 1\n")) wide.add(c);
+
+	jolly::jml_tape wide_tape;
+	res = jolly::jml_parse(wide_tape, core::stringview(wide.data, wide.size));
+	JOLLY_ASSERT(res.error == jolly::jml_error::too_long);
+}
+
+void test_jml_expr() {
+	LOG_INFO("% jml expressions", DIVIDE);
+
+	// expressions are folded where possible, the rest rerun when an input changes
+	jolly::jml_tape exprs;
+	auto res = jolly::jml_parse(exprs, "a = 2\nb = a * 3\nc = b + 1\nd = 5 * (2 + 1)\ne = { f = -c * 2 }\n");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	JOLLY_ASSERT(exprs.program.exprs.size == 3);
+
+	u64 root = jolly::JML_HASH_SEED;
+	u32 a = exprs.lookup(jolly::jml_hash_child(root, "a"), "a");
+	u32 f = exprs.lookup(jolly::jml_hash_child(jolly::jml_hash_child(root, "e"), "f"), "f");
+	JOLLY_ASSERT(exprs.num(f) == -14.0);
+	JOLLY_ASSERT(exprs.set(a, 4) == 3);
+	JOLLY_ASSERT(exprs.num(f) == -26.0);
+}
+
+void test_jml_binary() {
+	LOG_INFO("% jml binary", DIVIDE);
+
+	// the doc api reads either form
+	auto res = jolly::jml_convert("../test/test.jml", "test.jmlb");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+
+	jolly::jml_doc binary;
+	res = jolly::jml_load(binary, "test.jmlb");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	JOLLY_ASSERT(binary["mydict"]["inner"]["myval"].get<f64>() == 4.0);
+	JOLLY_ASSERT(binary["mystring"].get<core::string>() == core::string("hello world"));
+	JOLLY_ASSERT(binary["myeval"].get<f64>() == -4.0);
+
+	// mapped images write back out the same way tapes do
+	{
+		auto out = core::fopen("write.jml", core::access::wo | core::access::trunc);
+		jolly::jml_write(binary.image, out, jolly::jml_style::compact);
+	}
+
+	jolly::jml_doc written;
+	res = jolly::jml_load(written, "write.jml");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	JOLLY_ASSERT(written["mydict"]["inner"]["myval"].get<f64>() == 4.0);
+
+	// a full index would make lookups spin, a key past the string pool would read outside
+	// the image, both are rejected when the file is opened
+	core::vector<u8> good{};
+	{
+		auto src = core::fopen("test.jmlb", core::access::ro);
+		src.read(good);
+	}
+
+	auto corrupt = [&](auto edit) {
+		core::vector<u8> bytes(good.size);
+		bytes.size = good.size;
+		core::copy8(good.data, bytes.data, good.size);
+		edit(*(ptr<jolly::jml_header>)bytes.data, bytes.data);
+		{
+			auto dst = core::fopen("bad.jmlb", core::access::wo | core::access::trunc);
+			dst.write(core::membuf{ bytes.data, bytes.size });
+		}
+
+		jolly::jml_image bad;
+		return jolly::jml_open(bad, "bad.jmlb").error;
+	};
+
+	JOLLY_ASSERT(corrupt([](auto& header, ptr<u8> data) {}) == jolly::jml_error::none);
+	JOLLY_ASSERT(corrupt([](auto& header, ptr<u8> data) {
+		ptr<jolly::jml_slot> slots = (ptr<jolly::jml_slot>)(data + header.slots);
+		for (u32 i : range(header.slot_count)) slots[i].node = 1;
+	}) == jolly::jml_error::bad_image);
+	JOLLY_ASSERT(corrupt([](auto& header, ptr<u8> data) {
+		ptr<jolly::jml_node> nodes = (ptr<jolly::jml_node>)(data + header.nodes);
+		nodes[1].key = header.string_bytes;
+	}) == jolly::jml_error::bad_image);
+}
+
+void test_jml_write() {
+	LOG_INFO("% jml write", DIVIDE);
+	jolly::jml_doc doc;
+	auto res = jolly::jml_load(doc, "../test/test.jml");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+
+	// written documents parse back to the same values in either style
+	jolly::jml_style styles[] = { jolly::jml_style::compact, jolly::jml_style::pretty };
+	for (auto style : styles) {
+		{
+			auto out = core::fopen("write.jml", core::access::wo | core::access::trunc);
+			jolly::jml_write(doc.tape, out, style);
+		}
+
+		jolly::jml_doc written;
+		res = jolly::jml_load(written, "write.jml");
+		JOLLY_ASSERT(res.error == jolly::jml_error::none);
+		JOLLY_ASSERT(written["mydict"]["inner"]["myval"].get<f64>() == 4.0);
+		JOLLY_ASSERT(written["mystring"].get<core::string>() == core::string("hello world"));
+		JOLLY_ASSERT(written["myeval"].get<f64>() == -4.0);
+	}
+}
+
+void test_jml_path() {
+	LOG_INFO("% jml path", DIVIDE);
+	jolly::jml_doc doc;
+	auto res = jolly::jml_load(doc, "../test/test.jml");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+
+	// path queries hash once and never insert
+	u32 entries = doc.data.size;
+	jolly::jml_path myval("mydict.inner.myval");
+	JOLLY_ASSERT(doc.find("mydict.inner.myval")->get<f64>() == 4.0);
+	JOLLY_ASSERT(doc.find(myval) == doc.find("mydict.inner.myval"));
+	JOLLY_ASSERT(!doc.find("mydict.inner.missing") && !doc.find("mydict..inner"));
+	JOLLY_ASSERT(doc.data.size == entries);
+	JOLLY_ASSERT(doc.tape.num(doc.tape.find(myval)) == 4.0);
+	JOLLY_ASSERT(doc.tape.find("mydict.missing") == jolly::JML_NONE);
+}
+
+void test_jml_diff() {
+	LOG_INFO("% jml diff", DIVIDE);
+	u64 root = jolly::JML_HASH_SEED;
+
+	// a reload only reports the entries that differ, tables follow their changed entries
+	jolly::jml_tape before, after;
+	jolly::jml_parse(before, "a = 1\nb = { c = 2, d = [ 1, 2 ] }\ne = \"x\"\n");
+	jolly::jml_parse(after, "a = 1\nb = { c = 3, d = [ 1, 2 ] }\nf = true\n");
+
+	core::vector<jolly::jml_change> changes(0);
+	jolly::jml_diff(before, after, changes);
+	JOLLY_ASSERT(changes.size == 4);
+
+	u64 b = jolly::jml_hash_child(root, "b");
+	JOLLY_ASSERT(changes[0].type == jolly::jml_change_type::changed && changes[0].hash == jolly::jml_hash_child(b, "c"));
+	JOLLY_ASSERT(after.num(changes[0].node) == 3.0);
+	JOLLY_ASSERT(changes[1].type == jolly::jml_change_type::changed && changes[1].hash == b);
+	JOLLY_ASSERT(changes[2].type == jolly::jml_change_type::added && changes[2].hash == jolly::jml_hash_child(root, "f"));
+	JOLLY_ASSERT(changes[3].type == jolly::jml_change_type::removed && changes[3].hash == jolly::jml_hash_child(root, "e"));
+
+	// entries of a new table are reported before the table itself
+	jolly::jml_tape nested;
+	jolly::jml_parse(nested, "a = 1\nb = { c = 3, d = [ 1, 2 ] }\ng = { h = { i = 1 } }\n");
+	changes.size = 0;
+	jolly::jml_diff(after, nested, changes);
+	JOLLY_ASSERT(changes.size == 4);
+
+	u64 g = jolly::jml_hash_child(root, "g");
+	JOLLY_ASSERT(changes[0].type == jolly::jml_change_type::added && changes[0].hash == jolly::jml_hash_child(jolly::jml_hash_child(g, "h"), "i"));
+	JOLLY_ASSERT(changes[1].hash == jolly::jml_hash_child(g, "h") && changes[2].hash == g);
+	JOLLY_ASSERT(changes[3].type == jolly::jml_change_type::removed && changes[3].hash == jolly::jml_hash_child(root, "f"));
+}
+
+// a large generated config of small tables, only run with the bench argument since it
+// writes about 10 MB of files, they are removed afterwards
+void test_jml_bench() {
+	LOG_INFO("% jml benchmark", DIVIDE);
+	core::vector<u8> text(0);
+	auto append = [&](core::stringview str) {
+		if (text.reserve < text.size + str.size) {
+			text.resize(core::max(text.reserve * 2, text.size + str.size));
+		}
+
+		core::copy8((ptr<u8>)str.data, &text[text.size], str.size);
+		text.size += str.size;
+	};
+
+	for (u32 i : range(100000)) {
+		char digits[16];
+		u32 count = 0;
+		for (u32 n = i; n || !count; n /= 10) {
+			digits[15 - count++] = '0' + n % 10;
+		}
+
+		append("entity");
+		append(core::stringview(&digits[16 - count], count));
+		append(" = {\n\tpos = [ 1.5, -2.25 ],\n\tname = \"enemy\",\n\thealth = 100,\n\tarmor = health * 0.5,\n\tvisible = true # flag\n}\n");
+	}
+
+	u32 bytes = text.size;
+	f32 ms = 0;
+	jolly::jml_doc big;
+	jolly::jml_result res;
+	{
+		core::timer timer(ms);
+		res = jolly::jml_parse(big, core::stringview((cptr<char>)text.data, text.size));
+	}
+
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	JOLLY_ASSERT(big["entity99999"]["armor"].get<f64>() == 50.0);
+	LOG_INFO("parsed % bytes into a doc in % ms", bytes, ms);
+
+	// the tape alone skips building the doc table
+	jolly::jml_tape tape;
+	{
+		core::timer timer(ms);
+		res = jolly::jml_parse(tape, core::stringview((cptr<char>)text.data, text.size));
+	}
+
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	u64 hash = jolly::jml_hash_child(jolly::jml_hash_child(jolly::JML_HASH_SEED, "entity512"), "name");
+	u32 node = tape.lookup(hash, "name");
+	JOLLY_ASSERT(node != jolly::JML_NONE && tape.str(node) == core::stringview("enemy"));
+	LOG_INFO("parsed % bytes into % tape nodes in % ms", bytes, tape.nodes.size, ms);
+
+	// binary files are mapped, opening one does no parsing at all
+	res = jolly::jml_save(tape, "big.jmlb");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+
+	{
+		jolly::jml_image image;
+		{
+			core::timer timer(ms);
+			res = jolly::jml_open(image, "big.jmlb");
+		}
+
+		JOLLY_ASSERT(res.error == jolly::jml_error::none);
+		node = image.lookup(hash, "name");
+		JOLLY_ASSERT(node != jolly::JML_NONE && image.str(node) == core::stringview("enemy"));
+		LOG_INFO("opened % binary nodes in % ms", image.node_count, ms);
+	}
+
+	{
+		auto out = core::fopen("big.jml", core::access::wo | core::access::trunc);
+		core::timer timer(ms);
+		jolly::jml_write(tape, out, jolly::jml_style::pretty);
+	}
+
+	LOG_INFO("wrote % tape nodes in % ms", tape.nodes.size, ms);
+
+	// the mapping is closed above, windows refuses to delete mapped files
+	std::remove("big.jmlb");
+	std::remove("big.jml");
+}
+
+void test_jml_reload() {
+	LOG_INFO("% jml reload", DIVIDE);
+	{
+		auto out = core::fopen("reload.jml", core::access::wo | core::access::trunc);
+		core::stringview text("a = 1\nb = { c = 2 }\n");
+		out.write(core::membuf{ (ptr<u8>)text.data, text.size });
+	}
+
+	struct seen {
+		u32 calls;
+		f64 value;
+	};
+
+	jolly::jml_reload reload;
+	u32 file = reload.watch("reload.jml");
+	JOLLY_ASSERT(reload.get(file).find("b.c") != jolly::JML_NONE);
+
+	seen inner{};
+	reload.subscribe(file, "b.c", [](ptr<void> user, cref<jolly::jml_tape> doc, cref<jolly::jml_change> change) {
+		auto& s = *(ptr<seen>)user;
+		s.calls++;
+		s.value = doc.num(change.node);
+	}, &inner);
+
+	seen added{};
+	reload.subscribe(file, "d.e", [](ptr<void> user, cref<jolly::jml_tape> doc, cref<jolly::jml_change> change) {
+		auto& s = *(ptr<seen>)user;
+		s.calls++;
+		s.value = doc.num(change.node);
+	}, &added);
+
+	{
+		auto out = core::fopen("reload.jml", core::access::wo | core::access::trunc);
+		core::stringview text("a = 1\nb = { c = 5 }\nd = { e = 7 }\n");
+		out.write(core::membuf{ (ptr<u8>)text.data, text.size });
+	}
+
+	// write times can share a timer tick with the first write, force the poll to reparse
+	auto& watched = *reload._files[file];
+	watched.modified = 0;
+	reload._poll(watched, true);
+	JOLLY_ASSERT(watched.ready);
+	JOLLY_ASSERT(inner.calls == 0);
+
+	reload.step(0);
+	JOLLY_ASSERT(!watched.ready);
+	JOLLY_ASSERT(inner.calls == 1 && inner.value == 5.0);
+	JOLLY_ASSERT(added.calls == 1 && added.value == 7.0);
+	JOLLY_ASSERT(reload.get(file).num(reload.get(file).find("d.e")) == 7.0);
+
+	// nothing changed on disk, nothing is delivered
+	reload._poll(watched, true);
+	reload.step(0);
+	JOLLY_ASSERT(inner.calls == 1);
+
+	// a file caught halfway through a write keeps the live stamp and is retried on the next write
+	auto rewrite = [](core::stringview text) {
+		auto out = core::fopen("reload.jml", core::access::wo | core::access::trunc);
+		out.write(core::membuf{ (ptr<u8>)text.data, text.size });
+	};
+
+	rewrite("a = 1\nb = { c = ");
+	watched.modified = 0;
+	reload._poll(watched, true);
+	JOLLY_ASSERT(!watched.ready && watched.modified == 0 && watched.failed != 0);
+
+	rewrite("a = 1\nb = { c = 6 }\nd = { e = 7 }\n");
+	watched.failed = core::fmodified("reload.jml");
+	reload._poll(watched, false);
+	JOLLY_ASSERT(!watched.ready);
+
+	reload._poll(watched, true);
+	JOLLY_ASSERT(watched.ready && watched.failed == 0);
+	reload.step(0);
+	JOLLY_ASSERT(inner.calls == 2 && inner.value == 6.0);
+}
+
 void test_spirv() {
 	jolly::spirv_parse("../assets/shaders/texture");
 }
 
-int main() {
+void test_jml_stream() {
+	LOG_INFO("% jml stream", DIVIDE);
+
+	struct counts {
+		u32 keys;
+		u32 tables;
+		u32 arrays;
+		u32 numbers;
+		f64 sum;
+	};
+
+	jolly::jml_handler handler{};
+	counts seen{};
+	handler.user = &seen;
+
+	// mydict is skipped whole, the stream stops at myfloat
+	handler.key = [](ptr<void> user, core::stringview name) {
+		auto& c = *(ptr<counts>)user;
+		c.keys++;
+		if (name == core::stringview("mydict")) return jolly::jml_action::skip;
+		if (name == core::stringview("myfloat")) return jolly::jml_action::stop;
+		return jolly::jml_action::next;
+	};
+
+	handler.begin_table = [](ptr<void> user) {
+		((ptr<counts>)user)->tables++;
+		return jolly::jml_action::next;
+	};
+
+	handler.begin_array = [](ptr<void> user) {
+		((ptr<counts>)user)->arrays++;
+		return jolly::jml_action::next;
+	};
+
+	handler.value = [](ptr<void> user, cref<jolly::jml_scalar> val) {
+		auto& c = *(ptr<counts>)user;
+		if (val.type == jolly::jml_type::num) {
+			c.numbers++;
+			c.sum += val.num;
+		}
+
+		return jolly::jml_action::next;
+	};
+
+	auto res = jolly::jml_stream("../test/test.jml", handler);
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+	JOLLY_ASSERT(seen.keys == 5); // myarray, mydict, myboolean, mystring, myfloat
+	JOLLY_ASSERT(seen.tables == 0 && seen.arrays == 1);
+	JOLLY_ASSERT(seen.numbers == 4 && seen.sum == 22.0);
+}
+
+struct bind_inner {
+	i32 count;
+	bool enabled;
+};
+
+struct bind_outer {
+	f64 speed;
+	math::vec3f color;
+	core::string name;
+	bind_inner inner;
+};
+
+template <>
+struct jolly::jml_schema<bind_inner> {
+	static constexpr jolly::jml_field fields[] = {
+		jolly::jml_bind<&bind_inner::count>("count"),
+		jolly::jml_bind<&bind_inner::enabled>("enabled"),
+	};
+};
+
+template <>
+struct jolly::jml_schema<bind_outer> {
+	static constexpr jolly::jml_field fields[] = {
+		jolly::jml_bind<&bind_outer::speed>("speed"),
+		jolly::jml_bind<&bind_outer::color>("color"),
+		jolly::jml_bind<&bind_outer::name>("name"),
+		jolly::jml_bind<&bind_outer::inner>("inner"),
+	};
+};
+
+// field names are hashed when the schema is compiled
+static_assert(jolly::jml_schema<bind_inner>::fields[0].hash == jolly::jml_hash_key("count", 5));
+
+void test_jml_bind() {
+	LOG_INFO("% jml bind", DIVIDE);
+
+	jolly::jml_tape tape;
+	auto res = jolly::jml_parse(tape, "speed = 2 * 1.5\ncolor = [ 1, 0.5, 0 ]\nname = \"player\"\nunused = 4\ninner = { count = 3, enabled = true }\n");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+
+	bind_outer out{};
+	u32 count = jolly::jml_bind_table(tape, 0, jolly::JML_HASH_SEED, out);
+	JOLLY_ASSERT(count == 4);
+	JOLLY_ASSERT(out.speed == 3.0);
+	JOLLY_ASSERT(out.color.x == 1.0f && out.color.y == 0.5f && out.color.z == 0.0f);
+	JOLLY_ASSERT(out.name == core::string("player"));
+	JOLLY_ASSERT(out.inner.count == 3 && out.inner.enabled);
+
+	// nested tables are bound by path, entries of other tables with the same key are not seen
+	res = jolly::jml_parse(tape, "count = 9\nouter = { inner = { count = 4 } }\n");
+	JOLLY_ASSERT(res.error == jolly::jml_error::none);
+
+	bind_inner inner{};
+	JOLLY_ASSERT(jolly::jml_bind_path(tape, "outer.inner", inner) == 1);
+	JOLLY_ASSERT(inner.count == 4 && !inner.enabled);
+	JOLLY_ASSERT(jolly::jml_bind_path(tape, "outer.missing", inner) == 0);
+
+	// path handles, parsed tables and precomputed keys agree on the combined hash
+	u64 outer = jolly::jml_hash_child(jolly::JML_HASH_SEED, "outer");
+	JOLLY_ASSERT(jolly::jml_path("outer.inner").hash == jolly::jml_hash_combine(outer, jolly::jml_hash_key("inner", 5)));
+}
+
+// pass bench to also run the benchmarks
+int main(int argc, char** argv) {
+	bool bench = argc > 1 && std::string(argv[1]) == "bench";
+
 	test_assert();
 	test_thread();
 	test_atomics();
@@ -401,7 +1359,33 @@ int main() {
 	test_mutex();
 
 	test_ecs();
+	test_ecs_commands();
+	test_ecs_bulk();
+	test_ecs_tracking();
+	test_ecs_observers();
+	test_ecs_query();
+	test_ecs_snapshot();
+	test_ecs_sort();
+	test_ecs_column();
+	test_spatial();
+	test_transform();
+	test_prefab();
+	test_par_each();
+	test_triple_buffer();
 	test_convert();
 	test_jml();
+	test_jml_parse();
+	test_jml_expr();
+	test_jml_binary();
+	test_jml_write();
+	test_jml_path();
+	test_jml_diff();
+	test_jml_stream();
+	test_jml_bind();
+	test_jml_reload();
 	test_spirv();
+
+	if (bench) {
+		test_jml_bench();
+	}
 }